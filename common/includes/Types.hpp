@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include <niLang/STL/string.h>
 #include <niLang/STL/limits.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace spark {
 namespace common {
@@ -51,6 +54,17 @@ constexpr f32 skEpsilonL = skEpsilon * 4;
 #define skBitOff(flag,bit) (static_cast<u64>(flag) & ~static_cast<u64>(bit))
 #define skMask(flag,bit) (static_cast<u64>(flag) & static_cast<u64>(bit))
 #define skHasBit(flag,bit) (skMask(flag,bit) == static_cast<u64>(bit))
+
+// Index of the lowest set bit, undefined when v == 0.
+inline u32 skLowestBit64(u64 v) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return static_cast<u32>(idx);
+#else
+    return static_cast<u32>(__builtin_ctzll(v));
+#endif
+}
 inline u64 skSecsToNs(f64 secs) { return secs * 1000000000ULL; }
 inline f64 skNsToSecs(u64 ns) { return ns / 1000000000ULL; }
 
@@ -84,6 +84,16 @@ public:
             type_ = Type::String;
         }
     }
+    Value(const Value &v) {
+        type_ = v.type_;
+        if (type_ == Type::AllocatedString) {
+            ptr_ = new astl::string(*static_cast<const astl::string *>(v.ptr_));
+        }
+        else {
+            memcpy(&u8_, &v.u8_, 8);
+        }
+    }
+    Value &operator=(const Value &) = delete;
     ~Value() {
         // NOTE: We could just receive and run a deleter
         // but decided against it to save memory.
@@ -171,25 +181,40 @@ private:
 
 static_assert(sizeof(PackedValue) == 9, "PackedValue should be 9 bytes!");
 
+// NOTE: Data is laid out as named scopes holding named values, a value
+// being followed by the unnamed (inner) values it describes, eg. a count
+// and its elements. Readers expect everything in the order it was written.
 class DataWriter {
-    void push(const char *);
-    void write(const char *, Value);
-    void writeInner(Value);
-    bool pop();
-    void flush();
+public:
+    virtual ~DataWriter() {}
+
+    // Opens a named scope
+    virtual void push(const char *) = 0;
+    virtual void write(const char *, const Value &) = 0;
+    virtual void writeInner(const Value &) = 0;
+    // Closes the current scope
+    // @return Whether a scope was open
+    virtual bool pop() = 0;
+    virtual void flush() = 0;
 };
 
 class DataReader {
-    bool push(const char *);
-    Value read(const char *);
-    Value readInner();
-    bool pop();
+public:
+    virtual ~DataReader() {}
+
+    // Enters a named scope
+    // @return Whether the next scope has that name
+    virtual bool push(const char *) = 0;
+    virtual Value read(const char *) = 0;
+    virtual Value readInner() = 0;
+    virtual bool pop() = 0;
 };
 
 class Serializable {
 public:
     virtual void serialize(DataWriter *) = 0;
-    virtual void deserialize(DataReader *) = 0;
+    // @return False when the data could not be loaded
+    virtual bool deserialize(DataReader *) = 0;
 };
 
 } };
@@ -1,18 +1,97 @@
 #pragma once
 #include <Types.hpp>
 #include <GameGrid.hpp>
+#include <GameStats.hpp>
+
+#include <niLang/STL/vector.h>
 
 namespace spark {
 using namespace common;
 namespace game {
 
+class Combat;
+class Party;
+
+// NOTE: Fixed-timestep scheduler, update() accumulates the elapsed
+// nanoseconds and turns them into whole logic cycles, the remainder
+// being carried over to the next update.
+//
+// Pending cycles are fed in steps of at most catchUpStep() cycles to
+// grids, then the active party of each combat, then parties not in
+// combat. The stats table then computes its dirty rows, and deferred
+// grid events are dispatched at the end of each step. A single update never
+// runs more than maxCatchUpCycles(), when the host stalled for longer
+// the extra cycles are dropped and the update counts as an overrun,
+// instead of spiralling into ever longer updates.
 class Game {
 public:
+    // Default logic cycle length, in nanoseconds
+    static constexpr u64 kDefaultCycleTime = 1000000000ULL;
+    static constexpr u32 kDefaultMaxCatchUpCycles = 8;
+
     Game();
     ~Game();
     bool startup();
     bool shutdown();
-    void update(u64);
+
+    // Advances the simulation
+    // @param[in] Elapsed time, in nanoseconds
+    // @return Logic cycles run
+    u32 update(u64);
+
+    // Sets the logic cycle length
+    // @param[in] Nanoseconds per cycle, must be > 0
+    void setCycleTime(u64);
+    u64 cycleTime() const { return cycleTime_; }
+
+    // Sets the most cycles a single update can run
+    // @param[in] Cycles, must be > 0
+    void setMaxCatchUpCycles(u32);
+    u32 maxCatchUpCycles() const { return maxCatchUpCycles_; }
+
+    // Sets the most cycles folded into a single logicUpdate when catching up,
+    // 1 runs every cycle on its own
+    // @param[in] Cycles, must be > 0
+    void setCatchUpStep(u8);
+    u8 catchUpStep() const { return catchUpStep_; }
+
+    void addGrid(GameGrid *);
+    void removeGrid(GameGrid *);
+    void addCombat(Combat *);
+    void removeCombat(Combat *);
+    void addParty(Party *);
+    void removeParty(Party *);
+
+    // Sets the table whose derived stats get computed each step
+    // @param[in] Table, nullptr for none
+    void setStatsTable(StatsTable *table) { statsTable_ = table; }
+    StatsTable *statsTable() const { return statsTable_; }
+
+    // Logic cycles run since startup
+    u64 logicCycle() const { return logicCycle_; }
+
+    // Time accumulated towards the next cycle, in nanoseconds
+    u64 pendingTime() const { return pendingTime_; }
+
+    // Updates that had to drop cycles, and how many were dropped
+    u32 overruns() const { return overruns_; }
+    u64 droppedCycles() const { return droppedCycles_; }
+
+private:
+    void logicUpdate(u8);
+
+    astl::vector<GameGrid *> grids_;
+    astl::vector<Combat *> combats_;
+    astl::vector<Party *> parties_;
+    StatsTable *statsTable_ = nullptr;
+    u64 cycleTime_ = kDefaultCycleTime;
+    u32 maxCatchUpCycles_ = kDefaultMaxCatchUpCycles;
+    u8 catchUpStep_ = 1;
+    bool running_ = false;
+    u64 pendingTime_ = 0;
+    u64 logicCycle_ = 0;
+    u32 overruns_ = 0;
+    u64 droppedCycles_ = 0;
 };
 
 }
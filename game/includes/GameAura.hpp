@@ -3,6 +3,11 @@
 #include <MathTypes.hpp>
 
 #include "GameStats.hpp"
+#include "GameAuraRecord.hpp"
+
+#include <niLang/STL/hash_map.h>
+#include <niLang/STL/memory.h>
+#include <niLang/STL/vector.h>
 #include "objects/Character.hpp"
 
 namespace spark {
@@ -11,6 +16,9 @@ using namespace common::math;
 namespace game {
 
 class Character;
+
+// Aura prototype, shared by every target it is applied to, which keep
+// their own AuraInstance of it.
 class Aura {
 public:
     enum class Type : u8 {
@@ -36,20 +44,26 @@ public:
         return t_ >= static_cast<u8>(Type::BeginStats) && t_ < static_cast<u8>(Type::EndStats);
     }
 
+    // Duration of auras that never expire on their own
+    static constexpr u16 kPermanent = AuraRecord::kPermanent;
+
     Aura(u32 uid, u16 duration)
         : uid_(uid)
         , duration_(duration) {
     }
     virtual Type type() const = 0;
     virtual const char *name() const = 0;
-    virtual void applyTo(Character *target);
-    virtual void expireFrom(Character *target);
-    virtual void logicUpdate(u8 logicCycle);
+    virtual void applyTo(Character *) {}
+    virtual void expireFrom(Character *) {}
     u32 uid() const { return uid_; }
+
+    // Logic cycles the aura lasts once applied, kPermanent for ever
+    //
+    // NOTE: Auras are shared by every target, targets keep track of
+    // when their own application expires.
     u16 duration() const { return duration_; }
 
 private:
-    Character *target_ = nullptr;
     u32 uid_;
     u16 duration_;
 };
@@ -57,7 +71,7 @@ private:
 template <Stats::Type TYPE>
 class AdditiveAura : public Aura {
 public:
-    AdditiveAura(u32 uid, i32 add, u16 duration = astl::numeric_limits<u16>::max())
+    AdditiveAura(u32 uid, i32 add, u16 duration = kPermanent)
         : Aura(uid, duration)
         , add_(add) {}
 
@@ -80,7 +94,7 @@ private:
 template <Stats::Type TYPE>
 class MultiplicativeAura : public Aura {
 public:
-    MultiplicativeAura(u32 uid, f32 mul, u16 duration = astl::numeric_limits<u16>::max())
+    MultiplicativeAura(u32 uid, f32 mul, u16 duration = kPermanent)
         : Aura(uid, duration)
         , multiplier_(mul) {
     }
@@ -101,5 +115,59 @@ private:
     f32 multiplier_;
 };
 
+// Aura applied to a target.
+struct AuraInstance {
+    Aura *aura;
+    u32 sourceUid;
+    u32 expiry; // Cycle on the target's aura wheel, 0 when permanent
+};
+
+// Slab allocator of aura instances.
+//
+// NOTE: Instances are carved out of slabs of kSlabSize and recycled
+// through a free list, so applying an aura to many targets allocates
+// nothing once warm. Instances are not refcounted, the pool keeps one
+// reference per prototype instead, dropped with its last instance.
+class AuraPool {
+public:
+    static constexpr u32 kSlabSize = 256;
+
+    AuraPool() {}
+    AuraPool(const AuraPool &) = delete;
+    AuraPool &operator=(const AuraPool &) = delete;
+    ~AuraPool();
+
+    // Pool used by targets not given one
+    static AuraPool &shared();
+
+    // Instantiates an aura for a target
+    // @param[in] Prototype
+    // @param[in] Source uid
+    // @return Instance, to hand back to destroy
+    AuraInstance *create(const astl::shared_ptr<Aura> &, u32);
+
+    // Releases an instance, and its prototype along with the last one
+    // @param[in] Instance
+    void destroy(AuraInstance *);
+
+    u32 liveCount() const { return liveCount_; }
+    u32 slabCount() const { return slabs_.size(); }
+    u32 prototypeCount() const { return prototypes_.size(); }
+
+private:
+    struct Prototype {
+        astl::shared_ptr<Aura> aura;
+        u32 instances = 0;
+    };
+
+    astl::vector<astl::unique_ptr<AuraInstance[]>> slabs_;
+    astl::vector<AuraInstance *> free_;
+    astl::hash_map<const Aura *, Prototype> prototypes_;
+    // Last prototype instantiated, AoE buffs hit it in a row.
+    const Aura *lastAura_ = nullptr;
+    Prototype *lastPrototype_ = nullptr;
+    u32 liveCount_ = 0;
+};
+
 } // namespace game
 } // namespace spark
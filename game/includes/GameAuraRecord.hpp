@@ -0,0 +1,62 @@
+#pragma once
+#include <Types.hpp>
+
+#include "GameStats.hpp"
+
+namespace spark {
+using namespace common;
+namespace game {
+
+// Plain stat modifier, the data-only counterpart of AdditiveAura and
+// MultiplicativeAura.
+//
+// NOTE: Records are copied into their target, which keeps them in a
+// contiguous array and folds them into its stats through AuraModifiers,
+// without any virtual call nor allocation. Custom scripted effects still
+// go through the Aura class.
+struct AuraRecord {
+    enum class Op : u8 {
+        Additive = 0,
+        Multiplicative = 1,
+    };
+    // Duration of records that never expire on their own
+    static constexpr u16 kPermanent = astl::numeric_limits<u16>::max();
+
+    u32 uid;
+    u32 sourceUid; // Set by the target when applied
+    f32 magnitude; // Amount added, rounded, or added to the multiplier
+    u16 duration; // Logic cycles left when applied, kPermanent for ever
+    Stats::Type stat;
+    Op op;
+};
+
+// Modifiers of many records summed up per stat, to touch each stat once
+// however many records target it.
+//
+// NOTE: Additive magnitudes are rounded record by record before being
+// summed, so records expire exactly what they applied whatever batches
+// they were applied and expired in.
+struct AuraModifiers {
+    AuraModifiers() { reset(); }
+    void reset();
+
+    // Sums up records
+    // @param[in] Records
+    // @param[in] Record count
+    // @param[in] 1 to apply them, -1 to expire them
+    void accumulate(const AuraRecord *, u32, i32);
+
+    // Whole amount an additive magnitude stands for
+    static inline i32 roundMagnitude(f32 m) {
+        return static_cast<i32>(m + (m < 0.0f ? -0.5f : 0.5f));
+    }
+
+    // Applies the sums to the stats modifiers
+    // @param[in] Stats
+    void applyTo(Stats &) const;
+
+    f32 multiplier[static_cast<u8>(Stats::Type::Count)];
+    i32 additive[static_cast<u8>(Stats::Type::Count)];
+};
+
+}; }; // namespace spark::game
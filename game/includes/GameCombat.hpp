@@ -59,6 +59,10 @@ public:
     void nextParty(u8 logicCycles = 1u);
     u32 currentTurn() const { return turn_; }
 
+    // Feeds logic cycles to the active party, without ending its turn
+    // @param[in] Logic cycles
+    void tick(u8);
+
 private:
     void logicUpdate(u8) override;
     astl::vector<Party *> parties_;
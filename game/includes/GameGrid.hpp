@@ -1,6 +1,8 @@
 #pragma once
 #include <Types.hpp>
 #include <MathTypes.hpp>
+#include <ValueTypes.hpp>
+#include <GameGridTiles.hpp>
 
 #include <niLang/STL/vector.h>
 #include <niLang/STL/memory.h>
@@ -13,15 +15,51 @@ namespace game {
 
 // NOTE: 2 possibilities when generating grids,
 // a) Dynamically allocate the grid at run-time
-// b) Use templating to generate grid at compile-time (using config?)
-class GameGrid {
-private:
-    static constexpr u64 kFrameTimePerTurn = 1000000000ULL;
-
+// b) Use templating to generate grid at compile-time, see StaticGameGrid
+class GameGrid : public Serializable {
 public:
+    // Cells are indexed by tiles of kTileSize x kTileSize,
+    // a tile fits a u64 mask with one bit per cell, see GridTiles.
+    static constexpr u32 kTileShift = GridTiles::kTileShift;
+    static constexpr u32 kTileSize = GridTiles::kTileSize;
+    static constexpr u32 kTileMask = GridTiles::kTileMask;
+
+    // Chunked grids are split in kChunkSize x kChunkSize chunks.
+    static constexpr u32 kChunkShift = 6;
+    static constexpr u32 kChunkSize = 1u << kChunkShift;
+    static constexpr u32 kChunkMask = kChunkSize - 1;
+    static constexpr u32 kChunkArea = kChunkSize * kChunkSize;
+
+    // NOTE: RowMajor allocates and initializes every cell up front.
+    //
+    // Chunked only evaluates the cell types of a chunk the first time
+    // it is accessed, and only allocates its cells when they are not
+    // all of the same type or when something enters it. A chunk is
+    // released again once it is empty and uniform, whether its cells
+    // went back to their initial type or all got another one. Cell pointers of
+    // chunked grids are only valid until the next grid mutation, and
+    // the cells of a uniform chunk share the same address.
+    //
+    // Morton stores the cells tile by tile, tiles in row-major order,
+    // the cells of a tile along a Z-order curve. Cells close to each
+    // other on both axes share cache lines, for workloads reading 2D
+    // windows (eg. queries, field of view, flow fields). Rows are not
+    // contiguous, and the grid is padded to whole tiles.
+    enum class Layout : u8 {
+        RowMajor,
+        Chunked,
+        Morton,
+    };
+
+    // NOTE: A listener occupies size() cells anchored at its position
+    // (top-left), an empty size being a single cell. The footprint is
+    // captured on every move, resizing a listener only takes effect
+    // the next time it moves.
     class Listener {
     public:
         inline GameGrid *currentGrid() const { return grid_; }
+        // Cells currently occupied, from the last move
+        inline const SizeU &footprint() const { return footprint_; }
         virtual void setSize(SizeU) = 0;
         virtual SizeU size() const = 0;
         virtual void setPosition(PositionI) = 0;
@@ -33,8 +71,32 @@ public:
         virtual void onGridMoveRejected(u32) = 0;
         virtual void onGridMoved(PositionI, u32) = 0;
 
+        // Called by GameGrid::logicUpdate, eg. for grid-bound hazards
+        virtual void onGridLogicUpdate(u8) {}
+
+        // Called by GameGrid::logicUpdate when planning moves in parallel,
+        // possibly from a worker thread, see GameGrid::setParallelMovePlanning
+        // @param[in] Logic cycles
+        // @param[out] Position to move to
+        // @return Whether to move
+        virtual bool onGridPlanMove(u8, PositionI *) { return false; }
+
     private:
         GameGrid *grid_ = nullptr;
+        SizeU footprint_ = { 1, 1 };
+        // Index within GameGrid::listeners().
+        u32 slot_ = astl::numeric_limits<u32>::max();
+        // Request index while part of a moveBatch.
+        u32 batchIndex_ = astl::numeric_limits<u32>::max();
+        // Last query this listener was gathered by.
+        mutable u32 queryStamp_ = 0;
+        // Journal tick this listener was last recorded in,
+        // and its index within the journal while current.
+        u32 journalStamp_ = 0;
+        u32 journalSlot_ = 0;
+        // Dispatch this listener's deferred events were last grouped in.
+        u32 eventStamp_ = 0;
+        u32 eventGroup_ = 0;
         friend class GameGrid;
     };
 
@@ -43,6 +105,29 @@ public:
         Listener *data;
     };
 
+    // Read-only view over a contiguous run of cells,
+    // eg. a full row of the grid.
+    struct CellSpan {
+        const Cell *begin() const { return data; }
+        const Cell *end() const { return data + size; }
+        const Cell &operator[](u32 i) const { return data[i]; }
+        bool empty() const { return size == 0; }
+        const Cell *data;
+        u32 size;
+    };
+
+    struct MoveRequest {
+        Listener *listener;
+        PositionI target;
+        // Filled by moveBatch, as returned by the validator,
+        // or kMoveConflict
+        u32 result;
+    };
+    // Result of batch moves the validator accepted, but that were
+    // rejected by the other moves of the batch. Reserved, validators
+    // must not return it.
+    static constexpr u32 kMoveConflict = astl::numeric_limits<u32>::max();
+
     class MoveValidator {
     public:
         MoveValidator() = default;
@@ -54,15 +139,400 @@ public:
         virtual bool isError(u32 err) = 0;
     };
 
+    // Traits a cell gets from its type, see setTypeTraits.
+    // The first kTraitPlaneCount traits are kept in per-cell bit-planes,
+    // higher bits are free for game specific traits.
+    enum CellTrait : u32 {
+        kTraitWalkable = 1u << 0,
+        kTraitBlocksSight = 1u << 1,
+        kTraitDangerous = 1u << 2,
+    };
+    static constexpr u32 kTraitPlaneCount = 3;
+    static constexpr u32 kTraitPlaneMask = (1u << kTraitPlaneCount) - 1;
+
+    enum CellChangeFlags : u8 {
+        kCellTypeChanged = 1 << 0,
+        kCellOccupantChanged = 1 << 1,
+    };
+
+    struct CellChange {
+        u32 x;
+        u32 y;
+        // CellChangeFlags
+        u8 flags;
+    };
+
+    // Everything that changed since the last drain.
+    struct Journal {
+        // Tile by tile, row-major within a tile, each cell only once
+        astl::vector<CellChange> cells;
+        // Listeners still on the grid that entered or moved
+        astl::vector<Listener *> moved;
+        // One bit per tile, tile (tx,ty) is bit ty * tilesW + tx
+        astl::vector<u64> dirtyTiles;
+        u32 tilesW;
+        u32 tilesH;
+    };
+
     typedef astl::function<u32(const PositionI &)> initTypeFunc;
+    // Fills the types of a run of consecutive cells along a row
+    // @param[in] Position of the first cell
+    // @param[out] Types, one per cell
+    // @param[in] Cell count
+    typedef astl::function<void(const PositionI &, u32 *, u32)> initSpanFunc;
+    typedef astl::function<bool(u32)> blocksSightFunc;
+
+    // Initializes cell types one at a time
+    GameGrid(SizeU, astl::shared_ptr<MoveValidator>, initTypeFunc, Layout = Layout::RowMajor);
 
-    GameGrid(SizeU, astl::shared_ptr<MoveValidator>, initTypeFunc);
+    // Initializes cell types a span at a time
+    //
+    // NOTE: RowMajor grids are filled a whole row per call, the rows
+    // being split across worker threads, the function must then be
+    // safe to call concurrently. Chunked grids still initialize
+    // their chunks lazily, one chunk row per call, on the calling thread.
+    //
+    // @param[in] Size
+    // @param[in] Validator
+    // @param[in] Span initializer
+    // @param[in] Thread count, 1 fills the grid on the calling thread
+    // @param[in] Layout
+    GameGrid(SizeU, astl::shared_ptr<MoveValidator>, initSpanFunc, u32, Layout = Layout::RowMajor);
+
+    // Initializes every cell to the same type, without any callback
+    GameGrid(SizeU, astl::shared_ptr<MoveValidator>, u32, Layout = Layout::RowMajor);
     virtual ~GameGrid();
 
+    Layout layout() const { return layout_; }
+
+    // Advances the grid, notifying every listener on it
+    // @param[in] Logic cycles
     void logicUpdate(u8);
+
+    // NOTE: With parallel move planning, logicUpdate splits the grid
+    // into square regions and, once every listener got onGridLogicUpdate,
+    // asks the listeners of each region for the move they want through
+    // onGridPlanMove, regions being spread over worker threads. Only that
+    // hook runs on the workers, onGridLogicUpdate is always called on the
+    // calling thread, one listener after the other. Planning must only
+    // read the cells and the listener's own state, queries and any grid
+    // mutation are not thread-safe.
+    //
+    // Plans are then committed at once through a single moveBatch on
+    // the calling thread, region by region and listeners in listeners()
+    // order, moves leaving their region coming after all the others.
+    // The outcome does not depend on the thread count nor on which
+    // thread planned which region. Chunked grids evaluate their chunks
+    // lazily, they always plan on the calling thread.
+
+    // Enables or disables parallel move planning
+    // @param[in] Region size, in cells, 0 disables it
+    // @param[in] Thread count, including the calling thread
+    void setParallelMovePlanning(u32, u32);
+    u32 planningRegionSize() const { return planningRegionSize_; }
+    u32 planningThreads() const { return planningThreads_; }
+
+    // Moves planned during the last logicUpdate, and how many of them
+    // crossed a region border, for statistics only
+    u32 lastPlannedMoves() const { return lastPlannedMoves_; }
+    u32 lastCrossingMoves() const { return lastCrossingMoves_; }
+
+    // Logic cycles run since the grid was created
+    u64 logicCycle() const { return logicCycle_; }
+
     const Cell *cellAt(const PositionI &) const;
+
+    // Gets the cell at the given coordinates without bounds checking
+    // @param[in] X coordinate, must be < size().w()
+    // @param[in] Y coordinate, must be < size().h()
+    // @return Cell
+    inline const Cell *cellAtUnchecked(u32 x, u32 y) const {
+        if (layout_ != Layout::Chunked) {
+            return &cells_[cellIndex(x, y)];
+        }
+        return chunkCellAt(x, y);
+    }
+
+    // Gets a whole row of cells, RowMajor layout only
+    // @param[in] Row index
+    // @return Row span, empty when out of range or not contiguous
+    CellSpan row(u32) const;
+
+    // Gets the amount of chunks holding their own cells
+    // @return Allocated chunks, 0 unless Chunked
+    u32 allocatedChunks() const;
+
     bool leave(Listener *);
+
+    // Removes many listeners at once, same as leave() for each
+    // @param[in] Listeners
+    // @param[in] Listener count
+    // @return Listeners that were on the grid
+    u32 leaveMany(Listener *const *, u32);
+
+    // Moves a listener, entering the grid if needed
+    //
+    // NOTE: Every cell of the new footprint goes through the validator,
+    // the first error is returned, the anchor's result otherwise.
+    // Only cells that differ between the old and new footprints get
+    // stamped or cleared.
+    //
+    // @param[in] Listener
+    // @param[in] Position of the top-left cell
+    // @return Validator result
     u32 move(Listener *, const PositionI &);
+
+    // Moves many listeners one after the other, eg. when spawning a party,
+    // growing the listener list only once
+    // @param[in,out] Requests, results filled as returned by move()
+    // @param[in] Request count
+    // @return Accepted move count
+    u32 enterMany(MoveRequest *, u32);
+
+    // Moves many listeners at once, as if they all moved simultaneously
+    //
+    // NOTE: Every request is validated against the grid as it was
+    // before the batch, with the movers' own cells seen as free,
+    // so listeners can follow each other in chains.
+    // When several movers claim the same cell, the one already
+    // standing on it wins, then the one whose current cell comes
+    // first in row-major order, then listeners entering the grid
+    // in request order. A move into a cell whose occupant stays put
+    // is rejected, and so on down the chain. Movers rejected that way
+    // get kMoveConflict as their result, those rejected by the
+    // validator its own error.
+    //
+    // Listeners larger than a single cell do not take part in the
+    // resolution, they are moved one at a time in request order once
+    // all the others were committed, seen as standing still until then.
+    //
+    // Callbacks are only delivered once every move was committed,
+    // in request order.
+    //
+    // @param[in,out] Requests, a listener may appear only once
+    // @param[in] Request count
+    // @param[in] Whether two movers may trade places
+    // @return Accepted move count
+    u32 moveBatch(MoveRequest *, u32, bool = true);
+
+    // Changes the type of a cell
+    // @param[in] Position
+    // @param[in] Cell type
+    // @return Whether the position is within the grid
+    bool setCellType(const PositionI &, u32);
+
+    // NOTE: Every type or occupancy change bumps the grid revision
+    // and stamps the tile it happened in, so caches built from the grid
+    // (eg. flow fields) can tell whether their area was touched.
+
+    // Gets the current grid revision
+    u32 revision() const { return revision_; }
+
+    // Whether any cell within a rectangle changed since a given revision
+    // @param[in] Revision
+    // @param[in] Top-left corner (inclusive)
+    // @param[in] Bottom-right corner (inclusive)
+    // @param[in] Whether occupancy changes count, types always do
+    // @return Changed
+    bool changedSince(u32, const PositionI &, const PositionI &, bool = true) const;
+
+    // NOTE: With deferred events, move, leave and moveBatch queue their
+    // callbacks instead of delivering them while the grid is mutated.
+    // dispatchEvents() then delivers them grouped by listener, listeners
+    // in the order they first got an event, each one's events in the
+    // order they happened. Callbacks may move listeners again, those
+    // events are queued for the next dispatch. A listener must outlive
+    // the dispatch of its events, Game dispatches at the end of every
+    // logic cycle.
+
+    // Enables or disables deferred events, delivering the pending ones when disabling
+    // @param[in] Enabled
+    void setDeferredEvents(bool);
+    bool deferredEvents() const { return deferredEvents_; }
+
+    // Delivers the pending events, does nothing when called from a callback
+    // @return Delivered event count
+    u32 dispatchEvents();
+    u32 pendingEvents() const { return events_.size(); }
+
+    // NOTE: The journal records the cells whose type or occupant changed
+    // along with the listeners that moved, so consumers (eg. rendering,
+    // replication) only process what changed instead of scanning the grid.
+    // It only costs a mask update per change and is disabled by default.
+
+    // Enables or disables the change journal, clearing it
+    // @param[in] Enabled
+    void setJournalEnabled(bool);
+    bool journalEnabled() const { return journalEnabled_; }
+
+    // Whether a tile changed since the last drain
+    // @param[in] Tile X coordinate
+    // @param[in] Tile Y coordinate
+    // @return Dirty
+    inline bool isTileDirty(u32 tx, u32 ty) const {
+        if (!journalEnabled_ || tx >= tilesW_ || ty >= tilesH_) {
+            return false;
+        }
+        const u32 tile = ty * tilesW_ + tx;
+        return (dirtyTileBits_[tile >> 6] >> (tile & 63)) & 1;
+    }
+
+    // Moves the changes recorded since the last drain, usually once per tick
+    // @param[out] Journal, its previous content is discarded
+    void drainJournal(Journal &);
+
+    // NOTE: The trait registry maps cell types to trait masks, and keeps
+    // one bit-plane per plane trait, laid out like the occupancy index
+    // (one u64 per tile of kTileSize x kTileSize cells). Checking a trait
+    // then costs a single bit test, or covers a whole tile at once,
+    // instead of classifying Cell::type on every lookup.
+    //
+    // Registering traits rebuilds the planes, best done once up front.
+
+    // Sets the traits of a cell type
+    // @param[in] Cell type
+    // @param[in] CellTrait mask
+    void setTypeTraits(u32, u32);
+
+    // Sets the traits of many cell types at once
+    // @param[in] CellTrait masks, indexed by cell type
+    // @param[in] Type count
+    void setTypeTraits(const u32 *, u32);
+
+    // Gets the traits of a cell type
+    // @param[in] Cell type
+    // @return CellTrait mask, 0 when not registered
+    inline u32 typeTraits(u32 type) const {
+        return type < typeTraits_.size() ? typeTraits_[type] : 0;
+    }
+
+    // Whether the cell at the given coordinates has a trait
+    // @param[in] X coordinate, must be < size().w()
+    // @param[in] Y coordinate, must be < size().h()
+    // @param[in] Single CellTrait bit
+    // @return Has trait
+    inline bool hasTrait(u32 x, u32 y, u32 trait) const {
+        const Cell *c = cellAtUnchecked(x, y);
+        if (!(trait & kTraitPlaneMask)) {
+            return (typeTraits(c->type) & trait) != 0;
+        }
+        return (traitTileMask(trait, x >> kTileShift, y >> kTileShift) & tileBit(x, y)) != 0;
+    }
+
+    // Gets the cells of a tile having a plane trait,
+    // bit (y % kTileSize) * kTileSize + (x % kTileSize) for cell (x,y)
+    // @param[in] Single CellTrait bit, within kTraitPlaneMask
+    // @param[in] Tile X coordinate
+    // @param[in] Tile Y coordinate
+    // @return Cell mask
+    inline u64 traitTileMask(u32 trait, u32 tx, u32 ty) const {
+        if (typeTraits_.empty()) {
+            return 0;
+        }
+        if (layout_ == Layout::Chunked) {
+            // Planes of a chunk are filled when it is first accessed.
+            chunkCellAt(tx << kTileShift, ty << kTileShift);
+        }
+        const u32 tiles = tilesW_ * tilesH_;
+        return traitPlanes_[skLowestBit64(trait) * tiles + ty * tilesW_ + tx];
+    }
+
+    // Sets the predicate telling whether a cell type blocks sight,
+    // nothing blocks sight by default
+    // @param[in] Predicate on Cell::type
+    void setBlocksSight(blocksSightFunc);
+
+    // Whether the cell at the given coordinates blocks sight
+    // @param[in] X coordinate, must be < size().w()
+    // @param[in] Y coordinate, must be < size().h()
+    // @return Blocks sight
+    // @note Cells whose type has kTraitBlocksSight always block sight
+    inline bool blocksSight(u32 x, u32 y) const {
+        if (!typeTraits_.empty() && hasTrait(x, y, kTraitBlocksSight)) {
+            return true;
+        }
+        if (!blocksSight_) {
+            return false;
+        }
+        const u32 type = cellAtUnchecked(x, y)->type;
+        if (type < kSightCacheSize) {
+            return sightCache_[type] != 0;
+        }
+        return blocksSight_(type);
+    }
+
+    // Whether a straight line between two cells is not blocked,
+    // the end cells themselves are not tested.
+    // @note Symmetric, a sees b when b sees a
+    // @param[in] From
+    // @param[in] To
+    // @return Line of sight
+    bool hasLineOfSight(const PositionI &, const PositionI &) const;
+
+    // NOTE: Range queries only visit the occupied cells of the tiles
+    // overlapping the queried area, their cost does not depend
+    // on the total amount of listeners on the grid.
+    //
+    // A cell is within radius when skDistance would round
+    // its distance to the center to radius or less,
+    // matching the skill range checks.
+    //
+    // Listeners larger than a cell are gathered once, as soon as
+    // any of their cells lies within the queried area.
+
+    // Gathers the listeners around a position
+    // @param[in] Center
+    // @param[in] Radius, in cells
+    // @param[out] Listeners buffer
+    // @param[in] Buffer capacity
+    // @return Listener count written to the buffer
+    u32 queryRadius(const PositionI &, u32, Listener **, u32) const;
+
+    // Gathers the listeners within a rectangle
+    // @param[in] Top-left corner (inclusive)
+    // @param[in] Bottom-right corner (inclusive)
+    // @param[out] Listeners buffer
+    // @param[in] Buffer capacity
+    // @return Listener count written to the buffer
+    u32 queryRect(const PositionI &, const PositionI &, Listener **, u32) const;
+
+    // Gathers the listeners within a cone, the origin cell is excluded
+    // @param[in] Origin
+    // @param[in] Direction, does not need to be normalized
+    // @param[in] Range, in cells
+    // @param[in] Half angle of the cone, in radians
+    // @param[out] Listeners buffer
+    // @param[in] Buffer capacity
+    // @return Listener count written to the buffer
+    u32 queryCone(const PositionI &, const Array2I &, u32, f32, Listener **, u32) const;
+
+    // NOTE: Serialization stores the cell types, palette and run-length
+    // encoded in row-major order, followed by the listeners on the grid.
+    // Listeners are stored by id, through the functions given to
+    // setListenerIds, they are not stored at all without them.
+    //
+    // Loading requires a grid of the same size. The whole grid is read
+    // and checked first, and the grid is left untouched when anything is
+    // missing or out of range. DataReader only reads forward, so the
+    // palette, runs and listeners are kept until then, each bounded by
+    // the grid area (at most 2 u32 per cell for the runs). Each run then
+    // fills its cells a tile at a time, revisions, trait planes and
+    // journal being updated once per tile, and uniform chunks covered
+    // whole only change their uniform type. Every listener currently on
+    // the grid leaves and the stored ones are moved back in, going
+    // through the validator and callbacks as usual.
+
+    typedef astl::function<u32(const Listener *)> listenerIdFunc;
+    typedef astl::function<Listener *(u32)> listenerResolveFunc;
+
+    // Sets how listeners are identified when serializing
+    // @param[in] Gets the id of a listener
+    // @param[in] Gets a listener from its id, nullptr skips it
+    void setListenerIds(listenerIdFunc, listenerResolveFunc);
+
+    void serialize(DataWriter *) override;
+    bool deserialize(DataReader *) override;
+
     u32 area() const;
     SizeU size() const { return size_; }
 
@@ -70,15 +540,214 @@ public:
         return validator_.get();
     }
 
+    // NOTE: Listeners are kept in slots, leaving moves the last
+    // listener into the freed slot, the order is not stable.
     const astl::vector<Listener *> &listeners() {
         return listeners_;
     }
 
 private:
+    struct Chunk {
+        // Empty while the chunk is uniform.
+        astl::vector<Cell> cells;
+        // Type shared by all the cells of a uniform chunk.
+        Cell uniformCell;
+        u16 occupied;
+        // Cells whose type differs from uniformCell.type.
+        u16 nonUniform;
+        bool touched;
+    };
+
+    // Spreads the 3 low bits of a coordinate to the even bits.
+    static inline u32 mortonSpread(u32 v) {
+        v &= kTileMask;
+        v = (v | (v << 2)) & 0x33;
+        return (v | (v << 1)) & 0x15;
+    }
+    // Index within cells_, RowMajor and Morton layouts only.
+    inline u32 cellIndex(u32 x, u32 y) const {
+        if (layout_ == Layout::RowMajor) {
+            return y * size_.w() + x;
+        }
+        const u32 tile = (y >> kTileShift) * tilesW_ + (x >> kTileShift);
+        return (tile << (kTileShift * 2)) | (mortonSpread(y) << 1) | mortonSpread(x);
+    }
+    inline Chunk &chunkAt(u32 x, u32 y) const {
+        return chunks_[(y >> kChunkShift) * chunksW_ + (x >> kChunkShift)];
+    }
+    static inline u32 chunkCellIndex(u32 x, u32 y) {
+        return ((y & kChunkMask) << kChunkShift) | (x & kChunkMask);
+    }
+    inline const Cell *chunkCellAt(u32 x, u32 y) const {
+        Chunk &chunk = chunkAt(x, y);
+        if (!chunk.touched) {
+            touchChunk(chunk, x >> kChunkShift, y >> kChunkShift);
+        }
+        return chunk.cells.empty() ? &chunk.uniformCell : &chunk.cells[chunkCellIndex(x, y)];
+    }
+    // Sight predicate results for the lower types, filled up front so
+    // that blocksSight never writes, move planning calling it from
+    // worker threads.
+    static constexpr u32 kSightCacheSize = 1024;
+
+    void initStorage();
+    // Reads and checks a serialized grid, without changing anything.
+    bool readSerialized(DataReader *, astl::vector<u32> *, astl::vector<u32> *, astl::vector<u32> *) const;
+    // Sets the trait bits of cells of a tile to those of a type.
+    void setTraitBits(u32 tile, u64 bits, u32) const;
+    void rebuildTraitPlanes();
+    void touchChunk(Chunk &, u32, u32) const;
+    void materializeChunk(Chunk &);
+    void releaseChunkIfUnused(Chunk &);
+    // Cells of a chunk within the grid.
+    u32 chunkCellCount(u32, u32) const;
+    // Makes a type the uniform one when every cell of the chunk has it.
+    void rebaseChunk(Chunk &, u32, u32, u32);
+
+    inline Cell *rwCellAtUnchecked(u32 x, u32 y) {
+        if (layout_ != Layout::Chunked) {
+            return &cells_[cellIndex(x, y)];
+        }
+        Chunk &chunk = chunkAt(x, y);
+        if (!chunk.touched) {
+            touchChunk(chunk, x >> kChunkShift, y >> kChunkShift);
+        }
+        materializeChunk(chunk);
+        return &chunk.cells[chunkCellIndex(x, y)];
+    }
+    inline u32 tileIndex(u32 x, u32 y) const {
+        return GridTiles::tileIndex(x, y, tilesW_);
+    }
+    static inline u64 tileBit(u32 x, u32 y) {
+        return GridTiles::tileBit(x, y);
+    }
+
+    // Writes a cell type, keeping chunks bookkeeping but nothing else.
+    void storeType(u32 x, u32 y, u32);
+    // Records cells of a tile changed to a type: revision, trait planes
+    // and journal, once for all of them.
+    void typesChanged(u32 tile, u64 bits, u32);
+    // Sets the type of the row-major cell indices [begin, end),
+    // a tile at a time.
+    void fillTypes(u32 begin, u32 end, u32);
+
+    // All occupancy changes go through here to keep the index in sync.
+    void setOccupant(u32 x, u32 y, Listener *);
+
+    static inline SizeU footprintOf(const Listener *ggl) {
+        const SizeU s = ggl->size();
+        return { skMax(s.w(), 1u), skMax(s.h(), 1u) };
+    }
+    static inline bool isSingleCell(const SizeU &fp) {
+        return fp.w() == 1 && fp.h() == 1;
+    }
+    void journalCell(u32 x, u32 y, u8);
+    void journalTile(u32 tile, u64 typeBits, u64 occupantBits);
+    void journalMoved(Listener *);
+    enum class EventKind : u8 {
+        Entered,
+        Left,
+        Moved,
+        Rejected,
+    };
+    // Plans the listeners' moves region by region, then commits them.
+    void planMoves(u8);
+    // Delivers a callback, or queues it when deferred.
+    void notify(Listener *, EventKind, const PositionI &, u32);
+    void deliver(Listener *, EventKind, const PositionI &, u32);
+    // Constant time, the last listener takes the freed slot.
+    void addListener(Listener *);
+    void removeListener(Listener *);
+    u32 validateFootprint(Listener *, const PositionI &, const SizeU &);
+    // Stamps a footprint, skipping the cells within another one.
+    void stampFootprint(const PositionI &, const SizeU &, Listener *, const PositionI &, const SizeU &);
+    // Moves an already validated listener, without callbacks.
+    // @return Whether it entered the grid
+    bool placeFootprint(Listener *, const PositionI &, const SizeU &);
+    void setType(u32 x, u32 y, u32);
+
+    template <typename Pred>
+    u32 queryTiles(u32, u32, u32, u32, Pred, Listener **, u32) const;
+
     astl::shared_ptr<MoveValidator> validator_;
-    astl::vector<astl::vector<Cell>> grid_;
+    initTypeFunc initFunc_;
+    initSpanFunc initSpan_;
+    // Chunk row being initialized by initSpan_.
+    mutable astl::vector<u32> initScratch_;
+    blocksSightFunc blocksSight_;
+    astl::vector<u32> typeTraits_;
+    // kTraitPlaneCount planes of one mask per tile, plane after plane.
+    mutable astl::vector<u64> traitPlanes_;
+    astl::vector<u8> sightCache_;
+    Layout layout_;
+    // Row-major, cell (x,y) lives at index y * w + x.
+    astl::vector<Cell> cells_;
+    // Chunked, lazily initialized on first access.
+    mutable astl::vector<Chunk> chunks_;
+    u32 chunksW_ = 0;
+    // Occupied cells, one mask per tile.
+    astl::vector<u64> occupancy_;
+    // Last revision a tile's types/occupancy changed at.
+    struct TileRevision {
+        u32 type;
+        u32 occupancy;
+    };
+    astl::vector<TileRevision> tileRevisions_;
+    u32 revision_ = 0;
+    // Change journal, cells changed per tile since the last drain.
+    struct DirtyTile {
+        u64 type;
+        u64 occupant;
+    };
+    bool journalEnabled_ = false;
+    u32 journalTick_ = 1;
+    astl::vector<DirtyTile> dirtyTiles_;
+    astl::vector<u32> dirtyTileList_;
+    astl::vector<u64> dirtyTileBits_;
+    astl::vector<Listener *> journalMoved_;
     astl::vector<Listener *> listeners_;
-    u64 timeUntilNextTurn_ = kFrameTimePerTurn;
+    mutable u32 queryStamp_ = 0;
+    struct Event {
+        Listener *listener;
+        PositionI position;
+        u32 result;
+        u32 group;
+        EventKind kind;
+    };
+    bool deferredEvents_ = false;
+    bool dispatching_ = false;
+    u32 dispatchTick_ = 0;
+    astl::vector<Event> events_;
+    astl::vector<Event> dispatched_;
+    // moveBatch scratch buffers
+    struct BatchEntry {
+        u32 target;
+        u32 source;
+        u32 priority;
+        u32 dependent;
+        bool accepted;
+        bool entered;
+        bool large;
+    };
+    astl::vector<BatchEntry> batch_;
+    astl::vector<u32> batchOrder_;
+    u32 tilesW_ = 0;
+    u32 tilesH_ = 0;
+    u64 logicCycle_ = 0;
+    astl::vector<Listener *> updating_;
+    listenerIdFunc listenerIdFunc_;
+    listenerResolveFunc listenerResolveFunc_;
+    // Parallel move planning
+    u32 planningRegionSize_ = 0;
+    u32 planningThreads_ = 1;
+    u32 lastPlannedMoves_ = 0;
+    u32 lastCrossingMoves_ = 0;
+    // Listeners bucketed by region, region r spans [regionStart_[r], regionStart_[r + 1]).
+    astl::vector<u32> regionStart_;
+    astl::vector<u32> regionCursor_;
+    astl::vector<Listener *> regionListeners_;
+    astl::vector<astl::vector<MoveRequest>> regionPlans_;
+    astl::vector<MoveRequest> plannedMoves_;
     SizeU size_;
 };
 
@@ -0,0 +1,112 @@
+#pragma once
+#include <Types.hpp>
+#include <MathTypes.hpp>
+#include <GameGrid.hpp>
+
+#include <niLang/STL/hash_map.h>
+#include <niLang/STL/memory.h>
+#include <niLang/STL/vector.h>
+
+namespace spark {
+using namespace common;
+using namespace common::math;
+namespace game {
+
+// Copy-on-write view of a GameGrid, for speculative simulation
+// (eg. AI trying out move sequences before committing to one).
+//
+// NOTE: A snapshot starts out empty and reads straight through to the
+// grid. The first write to a tile copies that tile's cells into a page
+// owned by the snapshot, pages being shared with every snapshot copied
+// from it until one of them writes to it again. Copying a snapshot only
+// copies its page table, so branching costs the tiles touched so far,
+// never the grid size.
+//
+// Listeners are never notified nor moved for real, their snapshot
+// positions are tracked on the side. Snapshots assume the grid does not
+// change while they are in use, stale() tells when it did.
+class GameGridSnapshot {
+public:
+    typedef astl::function<bool(const GameGrid::Cell &)> walkableFunc;
+
+    // @param[in] Grid, must outlive the snapshot
+    // @param[in] Walkability predicate checked on moves, nullptr accepts any free cell
+    GameGridSnapshot(const GameGrid *, walkableFunc = nullptr);
+
+    // Gets a cell as seen by the snapshot
+    // @param[in] Position
+    // @return Cell, nullptr when out of the grid
+    const GameGrid::Cell *cellAt(const PositionI &) const;
+
+    // Changes the type of a cell within the snapshot
+    // @param[in] Position
+    // @param[in] Cell type
+    // @return Whether the position is within the grid
+    bool setCellType(const PositionI &, u32);
+
+    // Moves a listener within the snapshot, entering it if needed
+    //
+    // NOTE: The grid's MoveValidator is not involved, every cell of
+    // the footprint must be within the grid, free (or already held by
+    // the listener) and walkable.
+    //
+    // @param[in] Listener
+    // @param[in] Position of the top-left cell
+    // @return Whether the move was accepted
+    bool move(GameGrid::Listener *, const PositionI &);
+
+    // Removes a listener from the snapshot
+    // @param[in] Listener
+    // @return Whether it was on the snapshot
+    bool leave(GameGrid::Listener *);
+
+    // Gets the position of a listener within the snapshot
+    // @param[in] Listener
+    // @return Position, undefined when not on the snapshot
+    PositionI position(const GameGrid::Listener *) const;
+
+    // Whether the grid changed since the snapshot was taken
+    bool stale() const { return grid_->revision() != revision_; }
+
+    const GameGrid *grid() const { return grid_; }
+    SizeU size() const { return grid_->size(); }
+
+    // Tiles holding their own copy of the cells, shared or not
+    u32 pageCount() const { return pages_.size(); }
+
+private:
+    struct Page {
+        GameGrid::Cell cells[GameGrid::kTileSize * GameGrid::kTileSize];
+    };
+    struct Placement {
+        PositionI position;
+        SizeU footprint;
+    };
+
+    inline bool contains(i32 x, i32 y) const {
+        return static_cast<u32>(x) < grid_->size().w() && static_cast<u32>(y) < grid_->size().h();
+    }
+    inline u32 tileIndex(u32 x, u32 y) const {
+        return (y >> GameGrid::kTileShift) * tilesW_ + (x >> GameGrid::kTileShift);
+    }
+    static inline u32 pageIndex(u32 x, u32 y) {
+        return ((y & GameGrid::kTileMask) << GameGrid::kTileShift) | (x & GameGrid::kTileMask);
+    }
+    const GameGrid::Cell *cellAtUnchecked(u32, u32) const;
+    // Gets a cell for writing, copying its page if shared.
+    GameGrid::Cell *writableCell(u32, u32);
+    // Gets where a listener stands, and how large it is.
+    bool placement(const GameGrid::Listener *, Placement *) const;
+
+    const GameGrid *grid_;
+    walkableFunc walkableFunc_;
+    u32 revision_;
+    u32 tilesW_;
+    // Copied tiles, by tile index.
+    astl::hash_map<u32, astl::shared_ptr<Page>> pages_;
+    // Listeners moved or removed within the snapshot,
+    // left ones have an undefined position.
+    astl::hash_map<const GameGrid::Listener *, Placement> placements_;
+};
+
+}; }; // namespace spark::game
@@ -0,0 +1,80 @@
+#pragma once
+#include <Types.hpp>
+
+namespace spark {
+using namespace common;
+namespace game {
+
+// Tile arithmetic shared by GameGrid and StaticGameGrid.
+//
+// NOTE: Cells are grouped in tiles of kTileSize x kTileSize, one u64
+// mask per tile holding bit (y % kTileSize) * kTileSize + (x % kTileSize)
+// for cell (x,y). Tiles are stored row-major, tilesW per row.
+struct GridTiles {
+    static constexpr u32 kTileShift = 3;
+    static constexpr u32 kTileSize = 1u << kTileShift;
+    static constexpr u32 kTileMask = kTileSize - 1;
+    static_assert(kTileSize == 8, "A tile must fit a u64 mask");
+
+    // Gets the tile count covering a number of cells
+    // @param[in] Cells
+    // @return Tiles
+    static constexpr u32 tileCount(u32 cells) {
+        return (cells + kTileMask) >> kTileShift;
+    }
+
+    static constexpr u32 tileIndex(u32 x, u32 y, u32 tilesW) {
+        return (y >> kTileShift) * tilesW + (x >> kTileShift);
+    }
+
+    static constexpr u64 tileBit(u32 x, u32 y) {
+        return 1ull << (((y & kTileMask) << kTileShift) | (x & kTileMask));
+    }
+
+    // Gets the bits of the cells within [x0,x1] x [y0,y1] of a tile
+    // @param[in] Coordinates within the tile, all < kTileSize
+    // @return Mask
+    static constexpr u64 tileAreaMask(u32 x0, u32 y0, u32 x1, u32 y1) {
+        return (((0xFFull >> (7 - x1)) & (0xFFull << x0)) * 0x0101010101010101ull)
+            & (~0ull >> ((7 - y1) << 3)) & (~0ull << (y0 << 3));
+    }
+
+    // Visits the cells set in tile masks within a rectangle, tile by tile
+    // @param[in] Tile masks
+    // @param[in] Tiles per row
+    // @param[in] Rectangle, inclusive and within the grid
+    // @param[in] Called with each cell (x,y), returns false to stop
+    // @return False when stopped
+    template <typename Visit>
+    static bool forEachCell(const u64 *masks, u32 tilesW, u32 x0, u32 y0, u32 x1, u32 y1, Visit visit) {
+        const u32 tx0 = x0 >> kTileShift;
+        const u32 ty0 = y0 >> kTileShift;
+        const u32 tx1 = x1 >> kTileShift;
+        const u32 ty1 = y1 >> kTileShift;
+        for (u32 ty = ty0; ty <= ty1; ++ty) {
+            const u32 baseY = ty << kTileShift;
+            const u32 ly0 = ty == ty0 ? (y0 & kTileMask) : 0;
+            const u32 ly1 = ty == ty1 ? (y1 & kTileMask) : kTileMask;
+            for (u32 tx = tx0; tx <= tx1; ++tx) {
+                u64 mask = masks[ty * tilesW + tx];
+                if (!mask) {
+                    continue;
+                }
+                const u32 baseX = tx << kTileShift;
+                const u32 lx0 = tx == tx0 ? (x0 & kTileMask) : 0;
+                const u32 lx1 = tx == tx1 ? (x1 & kTileMask) : kTileMask;
+                mask &= tileAreaMask(lx0, ly0, lx1, ly1);
+                while (mask) {
+                    const u32 bit = skLowestBit64(mask);
+                    mask &= mask - 1;
+                    if (!visit(baseX + (bit & kTileMask), baseY + (bit >> kTileShift))) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+};
+
+}; }; // namespace spark::game
@@ -145,6 +145,8 @@ public:
     virtual void applyAttackDamage(const GameObject &, i32) = 0;
     virtual void applyAura(const GameObject &, astl::shared_ptr<Aura>) = 0;
     virtual void expireAura(Aura *) = 0;
+    virtual void applyAuraRecord(const GameObject &, const AuraRecord &) = 0;
+    virtual void expireAuraRecord(u32) = 0;
 
 protected:
     virtual Skill::CastError canCastSkillImpl(Skill **, u32, PositionI, const astl::shared_ptr<Skill::Params>) const;
@@ -171,6 +173,8 @@ public:
     void applyAttackDamage(const GameObject &, i32) override {}
     void applyAura(const GameObject &, astl::shared_ptr<Aura>) override {}
     void expireAura(Aura *) override {}
+    void applyAuraRecord(const GameObject &, const AuraRecord &) override {}
+    void expireAuraRecord(u32) override {}
 };
 
 }; }; // namespace spark::game
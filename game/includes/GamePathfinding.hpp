@@ -0,0 +1,403 @@
+#pragma once
+#include <Types.hpp>
+#include <MathTypes.hpp>
+#include <GameGrid.hpp>
+
+#include <niLang/STL/vector.h>
+#include <niLang/STL/hash_map.h>
+
+namespace spark {
+using namespace common;
+using namespace common::math;
+namespace game {
+
+static constexpr u32 kPathStraightCost = 10;
+static constexpr u32 kPathDiagonalCost = 14;
+
+// Cost multipliers of entering cells, per cell type.
+class CellCosts {
+public:
+    static constexpr u32 kDefaultTypeCost = 1;
+
+    // Sets the cost of entering cells of the given type
+    // @param[in] Cell type
+    // @param[in] Cost multiplier, must be > 0
+    void setTypeCost(u32, u32);
+
+    // Gets the cost of entering cells of the given type
+    // @param[in] Cell type
+    // @return Cost multiplier
+    inline u32 typeCost(u32 type) const {
+        return type < typeCosts_.size() ? typeCosts_[type] : kDefaultTypeCost;
+    }
+
+    // Lowest cost multiplier, keeps heuristics admissible
+    u32 minTypeCost() const { return minTypeCost_; }
+
+    // Whether every type costs kDefaultTypeCost
+    bool uniform() const { return uniform_; }
+
+private:
+    astl::vector<u32> typeCosts_;
+    u32 minTypeCost_ = kDefaultTypeCost;
+    bool uniform_ = true;
+};
+
+// NOTE: All search buffers are allocated once for the grid area,
+// a query only reuses them and does not touch the heap
+// (the output path aside, when its capacity is too small).
+//
+// Step costs are fixed-point, a straight step is worth kStraightCost
+// and a diagonal one kDiagonalCost, scaled by the cost of the
+// entered cell type.
+class Pathfinder {
+public:
+    enum class Algorithm : u8 {
+        AStar,
+        // Jump Point Search, only valid on uniform cost grids
+        // with diagonal moves, falls back to A* otherwise.
+        JumpPoint,
+    };
+
+    static constexpr u32 kStraightCost = kPathStraightCost;
+    static constexpr u32 kDiagonalCost = kPathDiagonalCost;
+
+    typedef astl::function<bool(const GameGrid::Cell &)> walkableFunc;
+
+    // @param[in] Grid
+    // @param[in] Walkability predicate, nullptr uses the grid's
+    //            kTraitWalkable plane, occupants being ignored
+    Pathfinder(const GameGrid *, walkableFunc);
+
+    void setTypeCost(u32 type, u32 cost) { costs_.setTypeCost(type, cost); }
+    u32 typeCost(u32 type) const { return costs_.typeCost(type); }
+
+    void setAllowDiagonal(bool allow) { allowDiagonal_ = allow; }
+    bool allowDiagonal() const { return allowDiagonal_; }
+
+    // Finds a path between two cells
+    // @param[in] Start, its own walkability is not checked
+    // @param[in] Goal
+    // @param[out] One position per step, start excluded, goal included
+    // @param[in] Algorithm
+    // @return Whether a path was found
+    bool findPath(const PositionI &, const PositionI &, astl::vector<PositionI> &, Algorithm = Algorithm::AStar);
+
+    // Cost of the last path found
+    u32 lastCost() const { return lastCost_; }
+
+    // Nodes expanded by the last query
+    u32 lastExpanded() const { return lastExpanded_; }
+
+private:
+    static constexpr u32 kNone = astl::numeric_limits<u32>::max();
+
+    inline bool walkable(i32 x, i32 y) const {
+        if (static_cast<u32>(x) >= width_ || static_cast<u32>(y) >= height_) {
+            return false;
+        }
+        if (!walkableFunc_) {
+            return grid_->hasTrait(x, y, GameGrid::kTraitWalkable);
+        }
+        return walkableFunc_(*grid_->cellAtUnchecked(x, y));
+    }
+    inline u32 nodeIndex(i32 x, i32 y) const { return y * width_ + x; }
+    u32 heuristic(i32, i32) const;
+    u32 stepCost(i32, i32, i32, i32) const;
+
+    void beginSearch(u32);
+    void relax(u32, u32, u32, i32, i32);
+    bool searchAStar();
+    bool searchJumpPoint();
+    bool jumpStraight(i32, i32, i32, i32, i32 *, i32 *) const;
+    bool jumpDiagonal(i32, i32, i32, i32, i32 *, i32 *) const;
+    void buildPath(u32, astl::vector<PositionI> &) const;
+
+    // Indexed binary heap on f, supporting decrease-key.
+    bool heapLess(u32, u32) const;
+    void heapPush(u32);
+    u32 heapPop();
+    void heapUp(u32);
+    void heapDown(u32);
+
+    const GameGrid *grid_;
+    walkableFunc walkableFunc_;
+    CellCosts costs_;
+    bool allowDiagonal_ = true;
+    u32 width_;
+    u32 height_;
+
+    // Per node buffers
+    astl::vector<u32> g_;
+    astl::vector<u32> f_;
+    astl::vector<u32> parent_;
+    astl::vector<u32> stamp_;
+    astl::vector<u32> heapPos_;
+    astl::vector<u32> heap_;
+    u32 heapSize_ = 0;
+    u32 searchId_ = 0;
+    i32 goalX_ = 0;
+    i32 goalY_ = 0;
+    u32 lastCost_ = 0;
+    u32 lastExpanded_ = 0;
+};
+
+// Dijkstra distance map towards a set of goals, along with
+// the direction to follow from every cell of the covered area.
+//
+// NOTE: Many agents chasing the same goals can share one field,
+// each of them reading its next step in constant time.
+// The field is only rebuilt by update() when its goals changed
+// or when the grid changed within the covered area.
+class FlowField {
+public:
+    static constexpr u32 kUnreachable = astl::numeric_limits<u32>::max();
+
+    // Covers the whole grid
+    FlowField(const GameGrid *, Pathfinder::walkableFunc);
+
+    // Covers a rectangle of the grid
+    // @param[in] Grid
+    // @param[in] Walkability predicate
+    // @param[in] Top-left corner (inclusive)
+    // @param[in] Bottom-right corner (inclusive)
+    FlowField(const GameGrid *, Pathfinder::walkableFunc, const PositionI &, const PositionI &);
+
+    void setTypeCost(u32, u32);
+    void setAllowDiagonal(bool);
+
+    // Whether occupancy changes invalidate the field, enable it
+    // when the walkability predicate looks at Cell::data
+    void setDependsOnOccupancy(bool);
+
+    // Sets the goals, the field is invalidated when they differ
+    // @param[in] Goals
+    // @param[in] Goal count
+    void setGoals(const PositionI *, u32);
+    void setGoal(const PositionI &p) { setGoals(&p, 1); }
+
+    // Whether the field is up to date with its goals & the grid
+    bool valid() const;
+
+    // Rebuilds the field when invalid
+    // @return Whether it was rebuilt
+    bool update();
+
+    // Gets the distance to the closest goal
+    // @param[in] Position
+    // @return Distance in step costs, kUnreachable when out of the field
+    u32 distance(const PositionI &) const;
+
+    // Gets the next step towards the closest goal
+    // @param[in] Current position
+    // @param[out] Next position
+    // @return Whether there is a step to take
+    bool nextStep(const PositionI &, PositionI *) const;
+
+private:
+    static constexpr u8 kNoDir = 0xFF;
+
+    inline bool contains(i32 x, i32 y) const {
+        return static_cast<u32>(x - min_.x()) < width_ && static_cast<u32>(y - min_.y()) < height_;
+    }
+    inline u32 localIndex(i32 x, i32 y) const {
+        return (y - min_.y()) * width_ + (x - min_.x());
+    }
+    inline bool walkable(i32 x, i32 y) const {
+        if (!contains(x, y)) {
+            return false;
+        }
+        if (!walkableFunc_) {
+            return grid_->hasTrait(x, y, GameGrid::kTraitWalkable);
+        }
+        return walkableFunc_(*grid_->cellAtUnchecked(x, y));
+    }
+    void build();
+
+    const GameGrid *grid_;
+    Pathfinder::walkableFunc walkableFunc_;
+    CellCosts costs_;
+    PositionI min_;
+    PositionI max_;
+    u32 width_;
+    u32 height_;
+    bool allowDiagonal_ = true;
+    bool dependsOnOccupancy_ = false;
+    bool dirty_ = true;
+    u32 builtRevision_ = 0;
+
+    astl::vector<PositionI> goals_;
+    astl::vector<u32> dist_;
+    astl::vector<u8> dir_;
+    // Open list of (distance << 32 | local index), lazily pruned.
+    astl::vector<u64> open_;
+};
+
+// Hierarchical A* (HPA*) over square clusters of the grid, for maps
+// too large for cell by cell searches.
+//
+// NOTE: Neighbouring clusters are linked through entrances, runs of
+// walkable cells along their shared border, each giving one or two
+// transition nodes per side. Nodes of a cluster are linked by the
+// cost of the shortest path staying within the cluster.
+// Queries search the abstract graph, only the clusters holding the
+// start and goal are searched cell by cell. Paths are near optimal,
+// cluster borders are only crossed orthogonally at transitions.
+//
+// Abstract waypoints are refined into cells on demand, segment per
+// segment, refined segments between transitions being cached.
+//
+// update() repairs the clusters whose cells changed since they were
+// built, along with their borders and direct neighbours, the rest of
+// the graph is kept as is.
+class HierarchicalPathfinder {
+public:
+    static constexpr u32 kDefaultClusterSize = 16;
+    // Entrances at least this wide get a transition at both ends.
+    static constexpr u32 kWideEntrance = 6;
+
+    // @param[in] Grid
+    // @param[in] Walkability predicate, nullptr uses the grid's kTraitWalkable plane
+    // @param[in] Cluster size, in cells, ideally a multiple of GameGrid::kTileSize
+    HierarchicalPathfinder(const GameGrid *, Pathfinder::walkableFunc, u32 = kDefaultClusterSize);
+
+    // Costs changes rebuild the whole graph
+    void setTypeCost(u32, u32);
+
+    // Whether occupancy changes dirty clusters, enable it
+    // when the walkability predicate looks at Cell::data
+    void setDependsOnOccupancy(bool);
+
+    // Builds the graph, or repairs the clusters that changed
+    // @return Repaired cluster count
+    u32 update();
+
+    // Finds an abstract path, updating the graph when needed
+    // @param[in] Start
+    // @param[in] Goal
+    // @param[out] Waypoints, start excluded, goal included
+    // @return Whether a path was found
+    bool findAbstractPath(const PositionI &, const PositionI &, astl::vector<PositionI> &);
+
+    // Refines the segment between two consecutive waypoints
+    // @param[in] From
+    // @param[in] To
+    // @param[out] One position per step, appended, from excluded, to included
+    // @return Whether the segment could be refined
+    bool refineSegment(const PositionI &, const PositionI &, astl::vector<PositionI> &);
+
+    // Finds an abstract path and refines it whole
+    // @param[in] Start
+    // @param[in] Goal
+    // @param[out] One position per step, start excluded, goal included
+    // @return Whether a path was found
+    bool findPath(const PositionI &, const PositionI &, astl::vector<PositionI> &);
+
+    // Cost of the last abstract path found
+    u32 lastCost() const { return lastCost_; }
+
+    u32 clusterSize() const { return clusterSize_; }
+    u32 clusterCount() const { return clustersW_ * clustersH_; }
+    u32 nodeCount() const { return nodeCount_; }
+
+private:
+    static constexpr u32 kNone = astl::numeric_limits<u32>::max();
+
+    struct Edge {
+        u32 to;
+        u32 cost;
+        // Crosses into a neighbouring cluster
+        bool inter;
+    };
+    struct Node {
+        u32 cell;
+        u32 cluster;
+        // Transitions referencing this node, freed when 0.
+        u32 refs;
+        astl::vector<Edge> edges;
+    };
+    struct Cluster {
+        u32 x0;
+        u32 y0;
+        u32 w;
+        u32 h;
+        astl::vector<u32> nodes;
+        // Refined paths between nodes, by (from cell << 32 | to cell).
+        astl::hash_map<u64, astl::vector<u32>> paths;
+    };
+    struct Border {
+        // Pairs of linked nodes, one per side.
+        astl::vector<u32> transitions;
+    };
+
+    inline bool walkable(i32 x, i32 y) const {
+        if (static_cast<u32>(x) >= width_ || static_cast<u32>(y) >= height_) {
+            return false;
+        }
+        if (!walkableFunc_) {
+            return grid_->hasTrait(x, y, GameGrid::kTraitWalkable);
+        }
+        return walkableFunc_(*grid_->cellAtUnchecked(x, y));
+    }
+    inline u32 clusterOf(u32 x, u32 y) const {
+        return (y / clusterSize_) * clustersW_ + (x / clusterSize_);
+    }
+    inline u32 typeCost(u32 cell) const {
+        return costs_.typeCost(grid_->cellAtUnchecked(cell % width_, cell / width_)->type);
+    }
+
+    void build();
+    void rebuildBorder(u32, bool);
+    void rebuildIntraEdges(u32);
+    u32 acquireNode(u32);
+    void releaseNode(u32);
+    void removeEdge(u32, u32);
+
+    // Dijkstra within a cluster, from a cell, or towards it when reversed.
+    // Stops early once the target cell, if any, is settled.
+    void searchCluster(u32, u32, bool, u32);
+    inline u32 localIndex(const Cluster &c, u32 cell) const {
+        return ((cell / width_) - c.y0) * c.w + ((cell % width_) - c.x0);
+    }
+    inline u32 localDistance(const Cluster &c, u32 cell) const {
+        return localDist_[localIndex(c, cell)];
+    }
+
+    const GameGrid *grid_;
+    Pathfinder::walkableFunc walkableFunc_;
+    CellCosts costs_;
+    u32 width_;
+    u32 height_;
+    u32 clusterSize_;
+    u32 clustersW_;
+    u32 clustersH_;
+    bool dependsOnOccupancy_ = false;
+    bool built_ = false;
+    u32 builtRevision_ = 0;
+
+    astl::vector<Cluster> clusters_;
+    // Between (cx,cy) and (cx+1,cy), then between (cx,cy) and (cx,cy+1).
+    astl::vector<Border> bordersH_;
+    astl::vector<Border> bordersV_;
+    astl::vector<Node> nodes_;
+    astl::vector<u32> freeNodes_;
+    astl::hash_map<u32, u32> nodeByCell_;
+    u32 nodeCount_ = 0;
+
+    // Cluster search buffers
+    astl::vector<u32> localDist_;
+    astl::vector<u32> localParent_;
+    astl::vector<u64> localOpen_;
+
+    // Abstract search buffers, the last two nodes being start & goal
+    astl::vector<u32> g_;
+    astl::vector<u32> parent_;
+    astl::vector<u32> stamp_;
+    astl::vector<u32> goalCost_;
+    astl::vector<u32> goalStamp_;
+    astl::vector<u64> open_;
+    u32 searchId_ = 0;
+    u32 lastCost_ = 0;
+};
+
+}; }; // namespace spark::game
@@ -6,6 +6,8 @@
 #include <niLang/STL/memory.h>
 #include <niLang/STL/map.h>
 
+#include <GameAuraRecord.hpp>
+
 namespace spark {
 using namespace common;
 using namespace common::math;
@@ -26,6 +28,7 @@ public:
         u32 attackDamage = 0;
         i32 spellDamage = 0; // negative spell damage is healing!
         astl::vector<astl::shared_ptr<Aura>> auras;
+        astl::vector<AuraRecord> auraRecords;
     };
     struct ResolutionInfo {
         GameObject *source;
@@ -52,7 +55,8 @@ public:
         OutOfRange,
         OutOfActionPoints,
         OnCooldown,
-        AlreadyCasting
+        AlreadyCasting,
+        OutOfSight
     };
 
     Skill(Bundle);
@@ -90,6 +94,10 @@ public:
         static const astl::vector<astl::shared_ptr<Aura>> kEmptyAurasDiff;
         return kEmptyAurasDiff;
     }
+    virtual const astl::vector<AuraRecord> &auraRecords() const {
+        static const astl::vector<AuraRecord> kEmptyAuraRecords;
+        return kEmptyAuraRecords;
+    }
 
     // Validates the cast request against internals & parameters
     // @param[in] Parameters
@@ -167,13 +175,21 @@ public:
         : Skill(bundle)
         , auras_({ aura }) {
     }
+    AuraSkill(Bundle bundle, const AuraRecord &record)
+        : Skill(bundle)
+        , auraRecords_({ record }) {
+    }
     virtual ~AuraSkill() {}
     const astl::vector<astl::shared_ptr<Aura>> &auras() const override {
         return auras_;
     }
+    const astl::vector<AuraRecord> &auraRecords() const override {
+        return auraRecords_;
+    }
 
 private:
     astl::vector<astl::shared_ptr<Aura>> auras_;
+    astl::vector<AuraRecord> auraRecords_;
 };
 
 } };
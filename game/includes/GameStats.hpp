@@ -74,11 +74,15 @@ public:
     };
     static constexpr bool isAttribute(const Type t) {
         return static_cast<u8>(t) >= static_cast<u8>(Type::BeginAttributes)
-            && static_cast<u8>(t) < static_cast<u8>(Type::EndAttributes);
+            && static_cast<u8>(t) <= static_cast<u8>(Type::EndAttributes);
     }
     static constexpr bool isStat(const Type t) {
         return static_cast<u8>(t) >= static_cast<u8>(Type::BeginStats)
-            && static_cast<u8>(t) < static_cast<u8>(Type::EndStats);
+            && static_cast<u8>(t) <= static_cast<u8>(Type::EndStats);
+    }
+    // Stats computeStats derives from the attributes
+    static constexpr bool isDerived(const Type t) {
+        return t == Type::MaxHitPoints || t == Type::AttackPower || t == Type::SpellPower;
     }
 
 private:
@@ -197,8 +201,11 @@ public:
         *os << stats.toString().c_str();
     }
 
-private:
+    // Whether attributes changed since the last computeStats
     inline bool dirty() const { return dirty_; }
+
+private:
+    friend class StatsTable;
     inline bool consumeDirty() {
         const bool ret = dirty_;
         dirty_ = false;
@@ -211,4 +218,105 @@ private:
     bool dirty_ = false;
 };
 
+// Stats of many characters, one column per field, eg. for thousands of NPCs.
+//
+// NOTE: Rows hold the same base/multiplier/additive triples as Stats,
+// but every field lives in its own contiguous array. computeStats()
+// then derives MaxHitPoints, AttackPower and SpellPower for all the
+// dirty rows in a single branch-free pass over the columns, which the
+// compiler can vectorize, instead of one call per object.
+// Rows are recycled, a removed row may be handed out again.
+//
+// Characters opt in through Character::setStatsTable, their derived
+// stats then come from the table, computed once per logic step by the
+// Game it is given to. Rows may have a listener told once they were
+// computed, eg. to clamp values bounded by derived stats.
+class StatsTable {
+public:
+    typedef u32 Row;
+    static constexpr Row kInvalidRow = astl::numeric_limits<u32>::max();
+    static constexpr u32 kColumnCount = static_cast<u32>(Stats::Type::Count);
+
+    class Listener {
+    public:
+        virtual ~Listener() {}
+
+    protected:
+        // ABSTRACT
+        // Called by computeStats once the derived stats of the row changed
+        virtual void onStatsComputed() = 0;
+
+    private:
+        friend class StatsTable;
+    };
+
+    StatsTable() = default;
+
+    // Adds a row, copying what Stats would keep on copy
+    // (attributes & action points), derived stats are computed
+    // on the next computeStats()
+    // @param[in] Stats
+    // @param[in] Listener of the row, nullptr for none
+    // @return Row
+    Row addRow(const Stats &, Listener * = nullptr);
+    void removeRow(Row);
+
+    // Copies the base values, but derived ones, and the modifiers of
+    // stats into a row, marking it dirty when attributes changed
+    // @param[in] Row
+    // @param[in,out] Stats, their dirty flag is consumed
+    void store(Row, Stats &);
+
+    bool isValid(Row r) const { return r < live_.size() && live_[r]; }
+
+    void set(Row, Stats::Type, i32);
+    inline i32 get(Row r, Stats::Type t) const {
+        return base_[static_cast<u8>(t)][r];
+    }
+    inline i32 computed(Row r, Stats::Type t) const {
+        const u8 c = static_cast<u8>(t);
+        return (base_[c][r] * multiplier_[c][r]) + additive_[c][r];
+    }
+
+    void applyStatMultiplier(Row, Stats::Type, f32);
+    void expireStatMultiplier(Row, Stats::Type, f32);
+    void applyStatAdditive(Row, Stats::Type, i32);
+    void expireStatAdditive(Row, Stats::Type, i32);
+    void resetAll(Row);
+    inline void markDirty(Row r) {
+        dirtyCount_ += dirty_[r] ? 0 : 1;
+        dirty_[r] = 1;
+    }
+    inline bool dirty(Row r) const { return dirty_[r] != 0; }
+
+    // Computes the derived stats of every dirty row, then tells
+    // their listeners
+    // @return Rows that were dirty
+    u32 computeStats();
+
+    // Rows in use
+    u32 rowCount() const { return live_.size() - freeRows_.size(); }
+
+private:
+    static constexpr bool affectsDerived(Stats::Type t) {
+        return Stats::isAttribute(t);
+    }
+    inline void touched(Row r, Stats::Type t) {
+        if (affectsDerived(t)) {
+            markDirty(r);
+        }
+    }
+
+    astl::vector<i32> base_[kColumnCount];
+    astl::vector<f32> multiplier_[kColumnCount];
+    astl::vector<i32> additive_[kColumnCount];
+    astl::vector<u8> dirty_;
+    astl::vector<u8> live_;
+    astl::vector<Listener *> listeners_;
+    astl::vector<Row> freeRows_;
+    // Rows with a listener computed by the last computeStats.
+    astl::vector<Row> computedRows_;
+    u32 dirtyCount_ = 0;
+};
+
 }; }; // namespace spark::game
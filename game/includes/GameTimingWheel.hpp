@@ -0,0 +1,148 @@
+#pragma once
+#include <Types.hpp>
+
+#include <niLang/STL/vector.h>
+
+namespace spark {
+using namespace common;
+namespace game {
+
+// Hierarchical timing wheel, schedules values to come out after a number
+// of logic cycles.
+//
+// NOTE: Level 0 holds one slot per cycle of the current 64 cycles
+// block, level 1 one slot per block of the current 4096 cycles, and so
+// on. Values are filed by their expiry cycle, and moved down a level
+// when the clock enters their slot, so advancing the clock only touches
+// the values that expire or cascade, never the whole set. Empty slots
+// are skipped through per level occupancy masks.
+//
+// Three levels cover 2^18 cycles ahead, more than any u16 delay.
+template <typename T>
+class TimingWheel {
+public:
+    static constexpr u32 kSlotBits = 6;
+    static constexpr u32 kSlots = 1u << kSlotBits;
+    static constexpr u32 kSlotMask = kSlots - 1;
+    static constexpr u32 kLevels = 3;
+    static constexpr u32 kMaxDelay = (1u << (kSlotBits * kLevels)) - 1;
+
+    // Schedules a value
+    // @param[in] Value
+    // @param[in] Cycles from now, clamped within [1, kMaxDelay]
+    // @return Expiry cycle, to cancel it
+    u32 schedule(const T &value, u32 delay) {
+        const u32 expiry = now_ + skClamp(delay, 1u, kMaxDelay);
+        file({ value, expiry });
+        ++size_;
+        return expiry;
+    }
+
+    // Unschedules a value
+    // @param[in] Value
+    // @param[in] Expiry cycle returned by schedule
+    // @return Whether it was still scheduled
+    bool cancel(const T &value, u32 expiry) {
+        u32 level, slot;
+        locate(expiry, &level, &slot);
+        astl::vector<Entry> &entries = slots_[level][slot];
+        skLoop(i, entries.size()) {
+            if (entries[i].expiry == expiry && entries[i].value == value) {
+                entries[i] = entries.back();
+                entries.pop_back();
+                if (entries.empty()) {
+                    masks_[level] &= ~(1ull << slot);
+                }
+                --size_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves the clock forward
+    // @param[in] Cycles
+    // @param[out] Values expired, appended in expiry order
+    void advance(u32 cycles, astl::vector<T> *expired) {
+        while (cycles > 0) {
+            if (size_ == 0) {
+                now_ += cycles;
+                return;
+            }
+            ++now_;
+            --cycles;
+            if ((now_ & kSlotMask) == 0) {
+                cascade(1);
+            }
+            const u32 slot = now_ & kSlotMask;
+            if (masks_[0] & (1ull << slot)) {
+                astl::vector<Entry> &entries = slots_[0][slot];
+                for (const Entry &e : entries) {
+                    expired->push_back(e.value);
+                }
+                size_ -= entries.size();
+                entries.clear();
+                masks_[0] &= ~(1ull << slot);
+            }
+        }
+    }
+
+    // Cycles elapsed since creation
+    u32 now() const { return now_; }
+    u32 size() const { return size_; }
+
+private:
+    struct Entry {
+        T value;
+        u32 expiry;
+    };
+
+    // Finds where an expiry cycle is filed, relative to the clock.
+    inline void locate(u32 expiry, u32 *level, u32 *slot) const {
+        u32 l = 0;
+        while (l + 1 < kLevels && (expiry >> ((l + 1) * kSlotBits)) != (now_ >> ((l + 1) * kSlotBits))) {
+            ++l;
+        }
+        *level = l;
+        *slot = (expiry >> (l * kSlotBits)) & kSlotMask;
+    }
+    inline void file(const Entry &e) {
+        u32 level, slot;
+        locate(e.expiry, &level, &slot);
+        slots_[level][slot].push_back(e);
+        masks_[level] |= 1ull << slot;
+    }
+    // Refiles the slot of a level the clock just entered,
+    // upper levels first as they may feed it.
+    void cascade(u32 level) {
+        if (level >= kLevels) {
+            return;
+        }
+        const u32 slot = (now_ >> (level * kSlotBits)) & kSlotMask;
+        if (slot == 0) {
+            cascade(level + 1);
+        }
+        if (masks_[level] & (1ull << slot)) {
+            cascading_.swap(slots_[level][slot]);
+            masks_[level] &= ~(1ull << slot);
+            for (const Entry &e : cascading_) {
+                file(e);
+            }
+            cascading_.clear();
+        }
+    }
+
+    astl::vector<Entry> slots_[kLevels][kSlots];
+    astl::vector<Entry> cascading_;
+    u64 masks_[kLevels] = { 0 };
+    u32 now_ = 0;
+    u32 size_ = 0;
+};
+
+template <typename T> constexpr u32 TimingWheel<T>::kSlotBits;
+template <typename T> constexpr u32 TimingWheel<T>::kSlots;
+template <typename T> constexpr u32 TimingWheel<T>::kSlotMask;
+template <typename T> constexpr u32 TimingWheel<T>::kLevels;
+template <typename T> constexpr u32 TimingWheel<T>::kMaxDelay;
+
+}; }; // namespace spark::game
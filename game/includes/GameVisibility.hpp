@@ -0,0 +1,69 @@
+#pragma once
+#include <Types.hpp>
+#include <MathTypes.hpp>
+#include <GameGrid.hpp>
+
+#include <niLang/STL/vector.h>
+
+namespace spark {
+using namespace common;
+using namespace common::math;
+namespace game {
+
+// Cells visible from an origin, using symmetric shadowcasting
+// over the grid's blocksSight predicate.
+//
+// NOTE: Visibility is symmetric, if a cell sees another one
+// the reverse holds true, and walls bounding the visible area
+// are revealed too. Results are kept in a bitset covering the
+// square window around the origin, reused across computations.
+class FieldOfView {
+public:
+    // @param[in] Grid
+    // @param[in] Largest radius compute() will be called with
+    FieldOfView(const GameGrid *, u32);
+
+    // Computes the visible cells
+    // @param[in] Origin
+    // @param[in] Radius, in cells, same rounding as GameGrid::queryRadius
+    void compute(const PositionI &, u32);
+
+    // Whether a cell was visible during the last compute
+    // @param[in] Position
+    // @return Visible
+    inline bool isVisible(const PositionI &p) const {
+        const u32 lx = p.x() - origin_.x() + maxRadius_;
+        const u32 ly = p.y() - origin_.y() + maxRadius_;
+        if (lx >= windowSize_ || ly >= windowSize_) {
+            return false;
+        }
+        const u32 bit = ly * windowSize_ + lx;
+        return (bits_[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    // Amount of visible cells
+    u32 visibleCount() const { return visibleCount_; }
+    const PositionI &origin() const { return origin_; }
+    u32 radius() const { return radius_; }
+
+private:
+    // Slopes are kept as fractions to avoid rounding issues.
+    struct Slope {
+        i32 num;
+        i32 den;
+    };
+    void reveal(i32, i32);
+    bool isWall(i32, i32) const;
+    void scan(u32, i32, Slope, Slope);
+
+    const GameGrid *grid_;
+    u32 maxRadius_;
+    u32 windowSize_;
+    astl::vector<u64> bits_;
+    PositionI origin_;
+    u32 radius_ = 0;
+    i64 maxDistSq_ = 0;
+    u32 visibleCount_ = 0;
+};
+
+}; }; // namespace spark::game
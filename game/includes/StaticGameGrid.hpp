@@ -0,0 +1,263 @@
+#pragma once
+#include <Types.hpp>
+#include <MathTypes.hpp>
+#include <GameGridTiles.hpp>
+
+#include <niLang/STL/array.h>
+#include <niLang/STL/memory.h>
+#include <niLang/STL/utils.h>
+
+namespace spark {
+using namespace common;
+using namespace common::math;
+namespace game {
+
+// Grid whose size is known at compile-time, for fixed-size maps (eg. arenas).
+//
+// NOTE: Mirrors the GameGrid Listener/MoveValidator contract, but all of
+// its storage lives inline, the grid never touches the heap. Indices are
+// computed from constant strides, letting the compiler fold the bounds
+// and index arithmetic of the move and query loops.
+//
+// CellT is the type of Cell::type, use a narrower one (eg. u8) to pack
+// more cells per cache line.
+template <u32 W, u32 H, typename CellT = u32>
+class StaticGameGrid {
+    static_assert(W > 0 && H > 0, "StaticGameGrid cannot be empty");
+
+public:
+    static constexpr u32 kWidth = W;
+    static constexpr u32 kHeight = H;
+    static constexpr u32 kArea = W * H;
+
+    // Occupancy is indexed by tiles of kTileSize x kTileSize, like GameGrid.
+    static constexpr u32 kTileShift = GridTiles::kTileShift;
+    static constexpr u32 kTileSize = GridTiles::kTileSize;
+    static constexpr u32 kTileMask = GridTiles::kTileMask;
+    static constexpr u32 kTilesW = GridTiles::tileCount(W);
+    static constexpr u32 kTilesH = GridTiles::tileCount(H);
+
+    class Listener {
+    public:
+        inline StaticGameGrid *currentGrid() const { return grid_; }
+        virtual void setSize(SizeU) = 0;
+        virtual SizeU size() const = 0;
+        virtual void setPosition(PositionI) = 0;
+        virtual PositionI position() const = 0;
+        virtual void onGridEntered(StaticGameGrid *) = 0;
+        virtual void onGridLeft(StaticGameGrid *) = 0;
+
+        // ABSTRACT
+        virtual void onGridMoveRejected(u32) = 0;
+        virtual void onGridMoved(PositionI, u32) = 0;
+
+    private:
+        StaticGameGrid *grid_ = nullptr;
+        // Index within StaticGameGrid::listeners().
+        u32 slot_ = 0;
+        friend class StaticGameGrid;
+    };
+
+    struct Cell {
+        CellT type;
+        Listener *data;
+    };
+
+    class MoveValidator {
+    public:
+        MoveValidator() = default;
+        virtual ~MoveValidator() {}
+
+        virtual u32 validateMove(StaticGameGrid *, Listener *, const PositionI &) = 0;
+        virtual bool isOK(u32 err) = 0;
+        virtual bool isWarning(u32 err) = 0;
+        virtual bool isError(u32 err) = 0;
+    };
+
+    // Only called while constructing, never stored.
+    typedef CellT (*initTypeFunc)(const PositionI &);
+
+    StaticGameGrid(astl::shared_ptr<MoveValidator> validator, initTypeFunc initFunc)
+        : validator_(validator) {
+        skLoop(y, H) {
+            skLoop(x, W) {
+                cells_[index(x, y)] = { initFunc({ x, y }), nullptr };
+            }
+        }
+        occupancy_.fill(0);
+    }
+
+    // Flattened index of a cell
+    // @param[in] X coordinate, must be < W
+    // @param[in] Y coordinate, must be < H
+    // @return Index
+    static constexpr u32 index(u32 x, u32 y) { return y * W + x; }
+
+    static constexpr bool contains(i32 x, i32 y) {
+        // Negative coordinates wrap around and fail the bounds check.
+        return static_cast<u32>(x) < W && static_cast<u32>(y) < H;
+    }
+
+    const Cell *cellAt(const PositionI &p) const {
+        return contains(p.x(), p.y()) ? &cells_[index(p.x(), p.y())] : nullptr;
+    }
+
+    // Gets the cell at the given coordinates without bounds checking
+    // @param[in] X coordinate, must be < W
+    // @param[in] Y coordinate, must be < H
+    // @return Cell
+    inline const Cell *cellAtUnchecked(u32 x, u32 y) const {
+        return &cells_[index(x, y)];
+    }
+
+    // Changes the type of a cell
+    // @param[in] Position
+    // @param[in] Cell type
+    // @return Whether the position is within the grid
+    bool setCellType(const PositionI &p, CellT type) {
+        if (!contains(p.x(), p.y())) {
+            return false;
+        }
+        cells_[index(p.x(), p.y())].type = type;
+        return true;
+    }
+
+    bool leave(Listener *ggl) {
+        if (ggl->currentGrid() != this) {
+            return false;
+        }
+        const PositionI p = ggl->position();
+        if (!contains(p.x(), p.y())) {
+            skUnreachable("Couldn't find cell at position(%d,%d)", p.x(), p.y());
+            return false;
+        }
+        Listener *last = listeners_[--listenerCount_];
+        listeners_[ggl->slot_] = last;
+        last->slot_ = ggl->slot_;
+        ggl->onGridLeft(this);
+        ggl->setPosition(PositionI::undefined());
+        ggl->grid_ = nullptr;
+        setOccupant(p.x(), p.y(), nullptr);
+        return true;
+    }
+
+    u32 move(Listener *ggl, const PositionI &p) {
+        const u32 ret = validator_->validateMove(this, ggl, p);
+        if (!validator_->isError(ret)) {
+            if (!ggl->currentGrid()) {
+                ggl->grid_ = this;
+                ggl->onGridEntered(this);
+                ggl->slot_ = listenerCount_;
+                listeners_[listenerCount_++] = ggl;
+            }
+            const PositionI prev = ggl->position();
+            if (prev != p && contains(prev.x(), prev.y())) {
+                setOccupant(prev.x(), prev.y(), nullptr);
+            }
+            setOccupant(p.x(), p.y(), ggl);
+            ggl->setPosition(p);
+            ggl->onGridMoved(p, ret);
+        }
+        else {
+            ggl->onGridMoveRejected(ret);
+        }
+        return ret;
+    }
+
+    // Gathers the listeners within a rectangle
+    // @param[in] Top-left corner (inclusive)
+    // @param[in] Bottom-right corner (inclusive)
+    // @param[out] Listeners buffer
+    // @param[in] Buffer capacity
+    // @return Listener count written to the buffer
+    u32 queryRect(const PositionI &a, const PositionI &b, Listener **out, u32 capacity) const {
+        const i32 x0 = skMax(skMin(a.x(), b.x()), 0);
+        const i32 y0 = skMax(skMin(a.y(), b.y()), 0);
+        const i32 x1 = skMin(skMax(a.x(), b.x()), static_cast<i32>(W) - 1);
+        const i32 y1 = skMin(skMax(a.y(), b.y()), static_cast<i32>(H) - 1);
+        if (x0 > x1 || y0 > y1) {
+            return 0;
+        }
+        return queryTiles(x0, y0, x1, y1, [](i32, i32) { return true; }, out, capacity);
+    }
+
+    // Gathers the listeners around a position, same rounding as GameGrid::queryRadius
+    // @param[in] Center
+    // @param[in] Radius, in cells
+    // @param[out] Listeners buffer
+    // @param[in] Buffer capacity
+    // @return Listener count written to the buffer
+    u32 queryRadius(const PositionI &center, u32 radius, Listener **out, u32 capacity) const {
+        const i32 r = static_cast<i32>(radius);
+        const i32 cx = center.x();
+        const i32 cy = center.y();
+        const i32 x0 = skMax(cx - r, 0);
+        const i32 y0 = skMax(cy - r, 0);
+        const i32 x1 = skMin(cx + r, static_cast<i32>(W) - 1);
+        const i32 y1 = skMin(cy + r, static_cast<i32>(H) - 1);
+        if (x0 > x1 || y0 > y1) {
+            return 0;
+        }
+        const i64 maxDistSq = static_cast<i64>(r) * r + r;
+        return queryTiles(x0, y0, x1, y1, [=](i32 x, i32 y) {
+            const i64 dx = x - cx;
+            const i64 dy = y - cy;
+            return dx * dx + dy * dy <= maxDistSq;
+        }, out, capacity);
+    }
+
+    static constexpr u32 area() { return kArea; }
+    static SizeU size() { return { W, H }; }
+
+    MoveValidator *validator() const {
+        return validator_.get();
+    }
+
+    // Listeners currently on the grid, in no particular order
+    Listener *const *listeners() const { return listeners_.data(); }
+    u32 listenerCount() const { return listenerCount_; }
+
+private:
+    void setOccupant(u32 x, u32 y, Listener *ggl) {
+        cells_[index(x, y)].data = ggl;
+        u64 &mask = occupancy_[GridTiles::tileIndex(x, y, kTilesW)];
+        const u64 bit = GridTiles::tileBit(x, y);
+        mask = ggl ? (mask | bit) : (mask & ~bit);
+    }
+
+    template <typename Pred>
+    u32 queryTiles(u32 x0, u32 y0, u32 x1, u32 y1, Pred pred, Listener **out, u32 capacity) const {
+        u32 count = 0;
+        GridTiles::forEachCell(occupancy_.data(), kTilesW, x0, y0, x1, y1, [&](u32 x, u32 y) {
+            if (!pred(static_cast<i32>(x), static_cast<i32>(y))) {
+                return true;
+            }
+            if (count >= capacity) {
+                return false;
+            }
+            out[count++] = cells_[index(x, y)].data;
+            return true;
+        });
+        return count;
+    }
+
+    astl::shared_ptr<MoveValidator> validator_;
+    // Row-major, cell (x,y) lives at index y * W + x.
+    astl::array<Cell, kArea> cells_;
+    // Occupied cells, one mask per tile.
+    astl::array<u64, kTilesW * kTilesH> occupancy_;
+    // At most one listener per cell.
+    astl::array<Listener *, kArea> listeners_;
+    u32 listenerCount_ = 0;
+};
+
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kWidth;
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kHeight;
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kArea;
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kTileShift;
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kTileSize;
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kTileMask;
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kTilesW;
+template <u32 W, u32 H, typename CellT> constexpr u32 StaticGameGrid<W, H, CellT>::kTilesH;
+
+}; }; // namespace spark::game
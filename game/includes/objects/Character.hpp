@@ -3,6 +3,7 @@
 #include <MathTypes.hpp>
 #include <GameObject.hpp>
 #include <GameSkill.hpp>
+#include <GameTimingWheel.hpp>
 
 #include <niLang/STL/memory.h>
 #include <niLang/STL/vector.h>
@@ -14,10 +15,12 @@ using namespace common::math;
 namespace game {
 
 class Aura;
-typedef astl::vector<astl::shared_ptr<Aura>> AurasVec;
+class AuraPool;
+struct AuraInstance;
+typedef astl::vector<AuraInstance *> AuraInstancesVec;
 typedef astl::vector<Skill *> ResolvingSkillsVec;
 
-class Character : public GameObject {
+class Character : public GameObject, private StatsTable::Listener {
 public:
     class EventListener {
     public:
@@ -67,9 +70,32 @@ public:
     void applyAttackDamage(const GameObject &from, i32) override;
     void applyAura(const GameObject &from, astl::shared_ptr<Aura>) override;
     void expireAura(Aura *) override;
+    void applyAuraRecord(const GameObject &from, const AuraRecord &) override;
+    void expireAuraRecord(u32) override;
+    // Records applied, in no particular order
+    const astl::vector<AuraRecord> &auraRecords() const { return auraRecords_; }
     virtual void logicUpdate(u8) override;
+
+    // Folds the auras applied or expired since the last call into the
+    // stats modifiers, then recomputes the stats depending on attributes
+    //
+    // NOTE: Modifiers are updated by deltas, each pending aura being
+    // applied or expired once, the others are left untouched. Pending
+    // records are summed up per stat and applied in one go.
     void processDirty();
 
+    // Rebuilds every modifier from scratch on each processDirty, reporting
+    // any difference with the incremental ones, for validation only
+    // @param[in] Enabled
+    void setAuraValidation(bool v) { auraValidation_ = v; }
+    bool auraValidation() const { return auraValidation_; }
+
+    // Sets the pool aura instances come from, AuraPool::shared() by default
+    // @param[in] Pool, must outlive the character
+    // @return False when auras are still applied
+    bool setAuraPool(AuraPool *);
+    AuraPool *auraPool() const { return auraPool_; }
+
     void registerEventListener(EventListener *);
     void unregisterEventListener(EventListener *);
 
@@ -78,11 +104,31 @@ public:
 
     const Stats &stats() const { return stats_; }
     Stats &rwStats() { return stats_; }
-    i32 attackPower() const { return stats_.computed(Stats::Type::AttackPower); }
-    i32 maxHitPoints() const { return stats_.computed(Stats::Type::MaxHitPoints); }
+    i32 attackPower() const { return computed(Stats::Type::AttackPower); }
+    i32 maxHitPoints() const { return computed(Stats::Type::MaxHitPoints); }
     i32 currentHitPoints() const { return currentHitPoints_; }
-    i32 maxActionPoints() const { return stats_.computed(Stats::Type::MaxActionPoints); }
-    i32 actionPointsRecovery() const { return stats_.computed(Stats::Type::ActionPointsRecovery); }
+    i32 maxActionPoints() const { return computed(Stats::Type::MaxActionPoints); }
+    i32 actionPointsRecovery() const { return computed(Stats::Type::ActionPointsRecovery); }
+
+    // Moves the stats computation to a shared table, nullptr to compute
+    // them on the character again
+    //
+    // NOTE: processDirty then only copies the stats into the table row,
+    // derived stats being computed along with every other row by
+    // StatsTable::computeStats. stats() keeps the base values and
+    // modifiers, but not the derived stats. Hit and action points are
+    // clamped once the row was computed.
+    //
+    // @param[in] Table, must outlive the character or be unset first
+    void setStatsTable(StatsTable *);
+    StatsTable *statsTable() const { return statsTable_; }
+
+    // Gets a stat with its modifiers, from the stats table when set
+    // @param[in] Stat
+    // @return Value
+    i32 computed(Stats::Type t) const {
+        return statsTable_ ? statsTable_->computed(statsRow_, t) : stats_.computed(t);
+    }
     i32 currentActionPoints() const { return currentActionPoints_; }
 
     // Increase/decrease action points
@@ -100,19 +146,46 @@ private:
 
     void clampHitPoints();
     void clampActionPoints();
+    void onStatsComputed() override;
     void doDamage(const GameObject &from, i32);
     i32 spellDamageFirstPass(const GameObject &from, i32);
     i32 attackDamageFirstPass(const GameObject &from, i32);
     inline void dirtyBuffs() { hasDirtyBuffs_ = true; }
     bool hasAura(u32) const;
+    void expireAuraAt(i32);
+    i32 auraRecordIndex(u32) const;
+    // Resets and reapplies every aura, logging the stats that changed.
+    void validateAuras();
 
     ResolvingSkillsVec resolvingSkills_;
     ListenersVec listeners_;
-    AurasVec auras_;
+    AuraPool *auraPool_;
+    AuraInstancesVec auras_;
+    astl::vector<AuraRecord> auraRecords_;
+    astl::vector<u32> auraRecordExpiries_;
+    // Aura instance, or record uid when there is none, filed on the wheel.
+    struct TimedAura {
+        AuraInstance *instance;
+        u32 recordUid;
+        bool operator==(const TimedAura &o) const { return instance == o.instance && recordUid == o.recordUid; }
+    };
+    TimingWheel<TimedAura> auraWheel_;
+    astl::vector<TimedAura> expiringAuras_;
+    u32 expiringCursor_ = 0;
+    // Drops an aura from the expiring batch, past the cursor.
+    void dropExpiring(const TimedAura &);
+    // Auras and records applied or expired since the last processDirty.
+    AuraInstancesVec appliedAuras_;
+    AuraInstancesVec expiredAuras_;
+    astl::vector<AuraRecord> appliedRecords_;
+    astl::vector<AuraRecord> expiredRecords_;
     Stats stats_;
+    StatsTable *statsTable_ = nullptr;
+    StatsTable::Row statsRow_ = StatsTable::kInvalidRow;
     i32 currentHitPoints_ = astl::numeric_limits<i32>::max();
     i32 currentActionPoints_ = astl::numeric_limits<i32>::max();
     bool hasDirtyBuffs_ = true;
+    bool auraValidation_ = false;
 };
 
 }; }; // namespace spark::game
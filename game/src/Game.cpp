@@ -0,0 +1,145 @@
+#include <Game.hpp>
+#include <GameCombat.hpp>
+
+namespace spark {
+namespace game {
+
+constexpr u64 Game::kDefaultCycleTime;
+constexpr u32 Game::kDefaultMaxCatchUpCycles;
+
+Game::Game() {
+}
+
+Game::~Game() {
+}
+
+bool Game::startup() {
+    if (running_) {
+        skLogE("Game::startup: Already running!");
+        return false;
+    }
+    running_ = true;
+    pendingTime_ = 0;
+    logicCycle_ = 0;
+    overruns_ = 0;
+    droppedCycles_ = 0;
+    return true;
+}
+
+bool Game::shutdown() {
+    if (!running_) {
+        skLogE("Game::shutdown: Not running!");
+        return false;
+    }
+    running_ = false;
+    grids_.clear();
+    combats_.clear();
+    parties_.clear();
+    return true;
+}
+
+void Game::setCycleTime(u64 cycleTime) {
+    if (cycleTime == 0) {
+        skLogW("Game::setCycleTime: cycle time must be > 0");
+        return;
+    }
+    cycleTime_ = cycleTime;
+}
+
+void Game::setMaxCatchUpCycles(u32 cycles) {
+    if (cycles == 0) {
+        skLogW("Game::setMaxCatchUpCycles: cycles must be > 0");
+        return;
+    }
+    maxCatchUpCycles_ = cycles;
+}
+
+void Game::setCatchUpStep(u8 cycles) {
+    if (cycles == 0) {
+        skLogW("Game::setCatchUpStep: cycles must be > 0");
+        return;
+    }
+    catchUpStep_ = cycles;
+}
+
+void Game::addGrid(GameGrid *grid) {
+    if (astl::find(grids_.begin(), grids_.end(), grid) == grids_.end()) {
+        grids_.push_back(grid);
+    }
+}
+
+void Game::removeGrid(GameGrid *grid) {
+    skFindErase(grids_, grid);
+}
+
+void Game::addCombat(Combat *combat) {
+    if (astl::find(combats_.begin(), combats_.end(), combat) == combats_.end()) {
+        combats_.push_back(combat);
+    }
+}
+
+void Game::removeCombat(Combat *combat) {
+    skFindErase(combats_, combat);
+}
+
+void Game::addParty(Party *party) {
+    if (astl::find(parties_.begin(), parties_.end(), party) == parties_.end()) {
+        parties_.push_back(party);
+    }
+}
+
+void Game::removeParty(Party *party) {
+    skFindErase(parties_, party);
+}
+
+u32 Game::update(u64 elapsed) {
+    if (!running_) {
+        return 0;
+    }
+    pendingTime_ += elapsed;
+    u64 cycles = pendingTime_ / cycleTime_;
+    pendingTime_ -= cycles * cycleTime_;
+    if (cycles > maxCatchUpCycles_) {
+        skLogW("Game::update: overrun, dropping %d logic cycles", static_cast<u32>(cycles - maxCatchUpCycles_));
+        ++overruns_;
+        droppedCycles_ += cycles - maxCatchUpCycles_;
+        cycles = maxCatchUpCycles_;
+    }
+
+    const u32 ran = static_cast<u32>(cycles);
+    while (cycles > 0) {
+        const u8 step = static_cast<u8>(skMin(cycles, static_cast<u64>(catchUpStep_)));
+        logicUpdate(step);
+        cycles -= step;
+    }
+    return ran;
+}
+
+void Game::logicUpdate(u8 logicCycle) {
+    logicCycle_ += logicCycle;
+    for (GameGrid *grid : grids_) {
+        grid->logicUpdate(logicCycle);
+    }
+    for (Combat *combat : combats_) {
+        // Only the party playing its turn runs, turns are
+        // handed over through Combat::nextParty.
+        combat->tick(logicCycle);
+    }
+    for (Party *party : parties_) {
+        // Parties in combat are updated on their turn only.
+        if (!party->currentCombat()) {
+            party->logicUpdate(logicCycle);
+        }
+    }
+    // Derived stats of the characters sharing a table, in one pass.
+    if (statsTable_) {
+        statsTable_->computeStats();
+    }
+    // Grid events deferred during the cycle.
+    for (GameGrid *grid : grids_) {
+        grid->dispatchEvents();
+    }
+}
+
+}
+}
@@ -5,30 +5,91 @@
 namespace spark {
 namespace game {
 
-void Aura::applyTo(Character *target) {
-    if (target_) {
-        skUnreachable("Aura::applyTo: Aura already has a target.");
-        return;
+constexpr u16 Aura::kPermanent;
+constexpr u16 AuraRecord::kPermanent;
+
+constexpr u32 AuraPool::kSlabSize;
+
+AuraPool::~AuraPool() {
+    if (liveCount_ > 0) {
+        skLogW("AuraPool::~AuraPool: %d instances still alive", liveCount_);
+    }
+}
+
+AuraPool &AuraPool::shared() {
+    static AuraPool pool;
+    return pool;
+}
+
+AuraInstance *AuraPool::create(const astl::shared_ptr<Aura> &aura, u32 sourceUid) {
+    if (aura.get() != lastAura_) {
+        Prototype &p = prototypes_[aura.get()];
+        if (!p.aura) {
+            p.aura = aura;
+        }
+        lastAura_ = aura.get();
+        lastPrototype_ = &p;
+    }
+    ++lastPrototype_->instances;
+
+    if (free_.empty()) {
+        slabs_.emplace_back(new AuraInstance[kSlabSize]);
+        AuraInstance *slab = slabs_.back().get();
+        skLoopr(i, kSlabSize) {
+            free_.push_back(slab + i);
+        }
     }
-    target_ = target;
+    AuraInstance *instance = free_.back();
+    free_.pop_back();
+    *instance = { aura.get(), sourceUid, 0 };
+    ++liveCount_;
+    return instance;
 }
 
-void Aura::expireFrom(Character *target) {
-    if (target_ != target) {
-        skUnreachable("Aura::expireFrom: Aura does not have a target.");
+void AuraPool::destroy(AuraInstance *instance) {
+    auto it = prototypes_.find(instance->aura);
+    if (it == prototypes_.end()) {
+        skUnreachable("AuraPool::destroy: Instance not from this pool.");
         return;
     }
-    target_ = nullptr;
+    if (--it->second.instances == 0) {
+        if (lastAura_ == instance->aura) {
+            lastAura_ = nullptr;
+            lastPrototype_ = nullptr;
+        }
+        prototypes_.erase(it);
+    }
+    instance->aura = nullptr;
+    free_.push_back(instance);
+    --liveCount_;
+}
+
+void AuraModifiers::reset() {
+    skLoop(i, Stats::Type::Count) {
+        multiplier[i] = 0.0f;
+        additive[i] = 0;
+    }
+}
+
+void AuraModifiers::accumulate(const AuraRecord *records, u32 count, i32 sign) {
+    // The op selects the sum the magnitude goes to, without branching.
+    skLoop(i, count) {
+        const AuraRecord &r = records[i];
+        const u8 s = static_cast<u8>(r.stat);
+        const i32 op = static_cast<i32>(r.op);
+        multiplier[s] += r.magnitude * static_cast<f32>(op * sign);
+        additive[s] += roundMagnitude(r.magnitude) * (1 - op) * sign;
+    }
 }
 
-void Aura::logicUpdate(u8 logicCycle) {
-    if (target_) {
-        if (duration_ <= logicCycle) {
-            duration_ = 0;
-            expireFrom(target_);
+void AuraModifiers::applyTo(Stats &stats) const {
+    skLoop(i, Stats::Type::Count) {
+        const Stats::Type t = static_cast<Stats::Type>(i);
+        if (multiplier[i] != 0.0f) {
+            stats.applyStatMultiplier(t, multiplier[i]);
         }
-        else {
-            duration_ -= logicCycle;
+        if (additive[i] != 0) {
+            stats.applyStatAdditive(t, additive[i]);
         }
     }
 }
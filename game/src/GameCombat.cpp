@@ -159,6 +159,12 @@ void Combat::logicUpdate(u8 logicCycle) {
     nextParty->logicUpdate(logicCycle);
 }
 
+void Combat::tick(u8 logicCycle) {
+    if (Party *party = currentParty()) {
+        party->logicUpdate(logicCycle);
+    }
+}
+
 Party *Combat::currentParty() const {
     return activeParty_ < parties_.size() ? parties_[activeParty_] : nullptr;
 }
@@ -3,91 +3,1354 @@
 #include <MathTypes.hpp>
 #include <GameObject.hpp>
 #include <niLang/STL/vector.h>
+#include <niLang/STL/hash_map.h>
+#include <math.h>
+#include <atomic>
+#include <thread>
 
 namespace spark {
 using namespace common;
 using namespace common::math;
 namespace game {
 
-GameGrid::GameGrid(SizeU gridDimensions, astl::shared_ptr<MoveValidator> validator, initTypeFunc initFunc)
+constexpr u32 GridTiles::kTileShift;
+constexpr u32 GridTiles::kTileSize;
+constexpr u32 GridTiles::kTileMask;
+constexpr u32 GameGrid::kTileShift;
+constexpr u32 GameGrid::kTileSize;
+constexpr u32 GameGrid::kTileMask;
+constexpr u32 GameGrid::kChunkShift;
+constexpr u32 GameGrid::kChunkSize;
+constexpr u32 GameGrid::kChunkMask;
+constexpr u32 GameGrid::kChunkArea;
+constexpr u32 GameGrid::kTraitPlaneCount;
+constexpr u32 GameGrid::kTraitPlaneMask;
+constexpr u32 GameGrid::kSightCacheSize;
+constexpr u32 GameGrid::kMoveConflict;
+
+GameGrid::GameGrid(SizeU gridDimensions, astl::shared_ptr<MoveValidator> validator, initTypeFunc initFunc, Layout layout)
     : validator_(validator)
+    , layout_(layout)
     , size_(gridDimensions) {
+    initStorage();
+    if (layout_ == Layout::Chunked) {
+        // Cell types get defined when a chunk is first accessed.
+        initFunc_ = initFunc;
+        return;
+    }
+
     const u32 w = gridDimensions.w();
     const u32 h = gridDimensions.h();
-    grid_.resize(h);
     PositionI p;
     skLoop(y, h) {
-        astl::vector<Cell> &row = grid_[y];
-        row.resize(w);
         p.y() = y;
         skLoop(x, w) {
             p.x() = x;
 
             // Define all cell types at init
-            row[x].type = initFunc(p);
+            cells_[cellIndex(x, y)].type = initFunc(p);
         }
     }
 }
 
+GameGrid::GameGrid(SizeU gridDimensions, astl::shared_ptr<MoveValidator> validator, initSpanFunc initSpan, u32 threads, Layout layout)
+    : validator_(validator)
+    , layout_(layout)
+    , size_(gridDimensions) {
+    initStorage();
+    if (layout_ == Layout::Chunked) {
+        initSpan_ = initSpan;
+        initScratch_.resize(kChunkSize);
+        return;
+    }
+
+    const u32 w = gridDimensions.w();
+    const u32 h = gridDimensions.h();
+    auto fillRows = [this, &initSpan, w](u32 y0, u32 y1) {
+        astl::vector<u32> types(w);
+        for (u32 y = y0; y < y1; ++y) {
+            initSpan(PositionI(0, y), types.data(), w);
+            skLoop(x, w) {
+                cells_[cellIndex(x, y)].type = types[x];
+            }
+        }
+    };
+    threads = skClamp(threads, 1u, skMax(h, 1u));
+    if (threads == 1) {
+        fillRows(0, h);
+        return;
+    }
+
+    // Contiguous bands of rows, the calling thread fills the last one.
+    astl::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    const u32 band = (h + threads - 1) / threads;
+    for (u32 y0 = 0; y0 < h; y0 += band) {
+        const u32 y1 = skMin(y0 + band, h);
+        if (y1 == h) {
+            fillRows(y0, y1);
+        }
+        else {
+            workers.emplace_back(fillRows, y0, y1);
+        }
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+GameGrid::GameGrid(SizeU gridDimensions, astl::shared_ptr<MoveValidator> validator, u32 type, Layout layout)
+    : validator_(validator)
+    , layout_(layout)
+    , size_(gridDimensions) {
+    initStorage();
+    if (layout_ == Layout::Chunked) {
+        // Every chunk starts out uniform, nothing to evaluate.
+        for (Chunk &chunk : chunks_) {
+            chunk.uniformCell = { type, nullptr };
+            chunk.touched = true;
+        }
+        return;
+    }
+    cells_.assign(cells_.size(), { type, nullptr });
+}
+
+void GameGrid::initStorage() {
+    const u32 w = size_.w();
+    const u32 h = size_.h();
+    tilesW_ = GridTiles::tileCount(w);
+    tilesH_ = GridTiles::tileCount(h);
+    occupancy_.resize(tilesW_ * tilesH_, 0);
+    tileRevisions_.resize(tilesW_ * tilesH_, { 0, 0 });
+
+    if (layout_ == Layout::Chunked) {
+        chunksW_ = (w + kChunkMask) >> kChunkShift;
+        const u32 chunksH = (h + kChunkMask) >> kChunkShift;
+        chunks_.resize(chunksW_ * chunksH);
+        for (Chunk &chunk : chunks_) {
+            chunk.uniformCell = { 0, nullptr };
+            chunk.occupied = 0;
+            chunk.nonUniform = 0;
+            chunk.touched = false;
+        }
+    }
+    else if (layout_ == Layout::Morton) {
+        // Padded to whole tiles.
+        cells_.resize(tilesW_ * tilesH_ * kTileSize * kTileSize, { 0, nullptr });
+    }
+    else {
+        cells_.resize(w * h, { 0, nullptr });
+    }
+}
+
 GameGrid::~GameGrid() {
 }
 
+void GameGrid::logicUpdate(u8 logicCycle) {
+    logicCycle_ += logicCycle;
+    // Listeners may leave or enter while being notified.
+    updating_ = listeners_;
+    for (Listener *ggl : updating_) {
+        if (ggl->currentGrid() == this) {
+            ggl->onGridLogicUpdate(logicCycle);
+        }
+    }
+    if (planningRegionSize_ > 0) {
+        planMoves(logicCycle);
+    }
+}
+
+void GameGrid::setParallelMovePlanning(u32 regionSize, u32 threads) {
+    if (threads == 0) {
+        skLogW("GameGrid::setParallelMovePlanning: thread count must be > 0");
+        threads = 1;
+    }
+    planningRegionSize_ = regionSize;
+    planningThreads_ = threads;
+    lastPlannedMoves_ = 0;
+    lastCrossingMoves_ = 0;
+}
+
+void GameGrid::planMoves(u8 logicCycle) {
+    const u32 regionSize = planningRegionSize_;
+    const u32 regionsW = (size_.w() + regionSize - 1) / regionSize;
+    const u32 regionsH = (size_.h() + regionSize - 1) / regionSize;
+    const u32 regionCount = regionsW * regionsH;
+    auto regionOf = [&](const PositionI &p) -> u32 {
+        return (p.y() / regionSize) * regionsW + (p.x() / regionSize);
+    };
+    // Targets out of the grid count as crossing, the validator rejects them.
+    auto staysIn = [&](const MoveRequest &req, u32 r) {
+        const u32 x = req.target.x();
+        const u32 y = req.target.y();
+        return x < size_.w() && y < size_.h() && regionOf(req.target) == r;
+    };
+
+    // Bucket the listeners by region, keeping their relative order.
+    regionStart_.assign(regionCount + 1, 0);
+    for (Listener *ggl : listeners_) {
+        ++regionStart_[regionOf(ggl->position()) + 1];
+    }
+    skLoop(r, regionCount) {
+        regionStart_[r + 1] += regionStart_[r];
+    }
+    regionListeners_.resize(listeners_.size());
+    regionCursor_.assign(regionStart_.begin(), regionStart_.end() - 1);
+    for (Listener *ggl : listeners_) {
+        regionListeners_[regionCursor_[regionOf(ggl->position())]++] = ggl;
+    }
+    if (regionPlans_.size() < regionCount) {
+        regionPlans_.resize(regionCount);
+    }
+
+    auto planRegion = [&](u32 r) {
+        astl::vector<MoveRequest> &plans = regionPlans_[r];
+        plans.clear();
+        for (u32 i = regionStart_[r]; i < regionStart_[r + 1]; ++i) {
+            Listener *ggl = regionListeners_[i];
+            PositionI target;
+            if (ggl->onGridPlanMove(logicCycle, &target)) {
+                plans.push_back({ ggl, target, 0 });
+            }
+        }
+    };
+    const u32 threads = layout_ == Layout::Chunked ? 1 : skMin(planningThreads_, regionCount);
+    if (threads <= 1) {
+        skLoop(r, regionCount) {
+            planRegion(r);
+        }
+    }
+    else {
+        // Regions are handed out one at a time, each one
+        // only writes its own plans.
+        std::atomic<u32> next { 0 };
+        auto work = [&]() {
+            for (u32 r = next++; r < regionCount; r = next++) {
+                planRegion(r);
+            }
+        };
+        astl::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        skLoop(i, threads - 1) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Moves staying within their region first, then those crossing a border.
+    plannedMoves_.clear();
+    skLoop(r, regionCount) {
+        for (const MoveRequest &req : regionPlans_[r]) {
+            if (staysIn(req, r)) {
+                plannedMoves_.push_back(req);
+            }
+        }
+    }
+    const u32 local = plannedMoves_.size();
+    skLoop(r, regionCount) {
+        for (const MoveRequest &req : regionPlans_[r]) {
+            if (!staysIn(req, r)) {
+                plannedMoves_.push_back(req);
+            }
+        }
+    }
+    lastPlannedMoves_ = plannedMoves_.size();
+    lastCrossingMoves_ = lastPlannedMoves_ - local;
+    if (!plannedMoves_.empty()) {
+        moveBatch(plannedMoves_.data(), plannedMoves_.size());
+    }
+}
+
+static constexpr u8 kSerializationVersion = 1;
+
+// Smallest value type able to hold every palette index.
+static inline common::Value paletteIndex(u32 index, u32 paletteSize) {
+    if (paletteSize <= 0x100) {
+        return common::Value(static_cast<u8>(index));
+    }
+    if (paletteSize <= 0x10000) {
+        return common::Value(static_cast<u16>(index));
+    }
+    return common::Value(index);
+}
+
+static inline bool readU32(const common::Value &v, u32 *out) {
+    switch (v.type()) {
+    case common::Value::Type::U8:
+        *out = v.valueAs<u8>();
+        return true;
+    case common::Value::Type::U16:
+        *out = v.valueAs<u16>();
+        return true;
+    case common::Value::Type::U32:
+        *out = v.valueAs<u32>();
+        return true;
+    default:
+        return false;
+    }
+}
+
+void GameGrid::setListenerIds(listenerIdFunc idFunc, listenerResolveFunc resolveFunc) {
+    listenerIdFunc_ = idFunc;
+    listenerResolveFunc_ = resolveFunc;
+}
+
+void GameGrid::serialize(DataWriter *writer) {
+    const u32 w = size_.w();
+    const u32 n = area();
+
+    // Palette in order of first appearance, and the run count.
+    astl::hash_map<u32, u32> indices;
+    astl::vector<u32> palette;
+    u32 runs = 0;
+    u32 prev = 0;
+    skLoop(i, n) {
+        const u32 type = cellAtUnchecked(i % w, i / w)->type;
+        if (indices.find(type) == indices.end()) {
+            indices[type] = palette.size();
+            palette.push_back(type);
+        }
+        if (i == 0 || type != prev) {
+            ++runs;
+            prev = type;
+        }
+    }
+
+    writer->push("GameGrid");
+    writer->write("version", common::Value(kSerializationVersion));
+    writer->write("width", common::Value(w));
+    writer->write("height", common::Value(size_.h()));
+
+    writer->write("palette", common::Value(static_cast<u32>(palette.size())));
+    for (u32 type : palette) {
+        writer->writeInner(common::Value(type));
+    }
+
+    writer->write("runs", common::Value(runs));
+    u32 start = 0;
+    skLoop(i, n + 1) {
+        const u32 type = i < static_cast<i32>(n) ? cellAtUnchecked(i % w, i / w)->type : 0;
+        if (i == static_cast<i32>(n) || (i > 0 && type != prev)) {
+            writer->writeInner(paletteIndex(indices[prev], palette.size()));
+            writer->writeInner(common::Value(i - start));
+            start = i;
+        }
+        prev = type;
+    }
+
+    const u32 listenerCount = listenerIdFunc_ ? listeners_.size() : 0;
+    writer->write("listeners", common::Value(listenerCount));
+    skLoop(i, listenerCount) {
+        const Listener *ggl = listeners_[i];
+        const PositionI p = ggl->position();
+        writer->writeInner(common::Value(listenerIdFunc_(ggl)));
+        writer->writeInner(common::Value(static_cast<u32>(p.x())));
+        writer->writeInner(common::Value(static_cast<u32>(p.y())));
+    }
+    writer->pop();
+    writer->flush();
+}
+
+bool GameGrid::deserialize(DataReader *reader) {
+    if (!reader->push("GameGrid")) {
+        skLogE("GameGrid::deserialize: No grid found!");
+        return false;
+    }
+    // Checks everything before touching the grid.
+    astl::vector<u32> palette;
+    astl::vector<u32> runs;
+    astl::vector<u32> listeners;
+    const bool ok = readSerialized(reader, &palette, &runs, &listeners);
+    reader->pop();
+    if (!ok) {
+        return false;
+    }
+
+    u32 i = 0;
+    for (u32 r = 0; r < runs.size(); r += 2) {
+        fillTypes(i, i + runs[r + 1], palette[runs[r]]);
+        i += runs[r + 1];
+    }
+
+    // Not updating_, a listener may load the grid from logicUpdate.
+    const astl::vector<Listener *> leaving = listeners_;
+    leaveMany(leaving.data(), leaving.size());
+    for (u32 l = 0; l < listeners.size(); l += 3) {
+        Listener *ggl = listenerResolveFunc_ ? listenerResolveFunc_(listeners[l]) : nullptr;
+        if (ggl) {
+            move(ggl, { static_cast<i32>(listeners[l + 1]), static_cast<i32>(listeners[l + 2]) });
+        }
+    }
+    return true;
+}
+
+bool GameGrid::readSerialized(DataReader *reader, astl::vector<u32> *palette, astl::vector<u32> *runs, astl::vector<u32> *listeners) const {
+    u32 version = 0;
+    u32 w = 0;
+    u32 h = 0;
+    if (!readU32(reader->read("version"), &version) || version != kSerializationVersion) {
+        skLogE("GameGrid::deserialize: Unsupported version %d", version);
+        return false;
+    }
+    if (!readU32(reader->read("width"), &w) || !readU32(reader->read("height"), &h)
+        || w != size_.w() || h != size_.h()) {
+        skLogE("GameGrid::deserialize: Size mismatch, got (%d,%d), expected (%d,%d)", w, h, size_.w(), size_.h());
+        return false;
+    }
+    const u32 n = area();
+
+    // Every type and run covers at least a cell.
+    u32 paletteSize = 0;
+    if (!readU32(reader->read("palette"), &paletteSize) || paletteSize > n || (n > 0 && paletteSize == 0)) {
+        skLogE("GameGrid::deserialize: Invalid palette size %d", paletteSize);
+        return false;
+    }
+    palette->resize(paletteSize);
+    for (u32 &type : *palette) {
+        if (!readU32(reader->readInner(), &type)) {
+            skLogE("GameGrid::deserialize: Truncated palette");
+            return false;
+        }
+    }
+    u32 runCount = 0;
+    if (!readU32(reader->read("runs"), &runCount) || runCount > n) {
+        skLogE("GameGrid::deserialize: Invalid run count %d", runCount);
+        return false;
+    }
+    runs->resize(runCount * 2);
+    u32 covered = 0;
+    skLoop(r, runCount) {
+        u32 &index = (*runs)[r * 2];
+        u32 &length = (*runs)[r * 2 + 1];
+        if (!readU32(reader->readInner(), &index) || !readU32(reader->readInner(), &length)
+            || index >= paletteSize || length == 0 || length > n - covered) {
+            skLogE("GameGrid::deserialize: Corrupted run %d", r);
+            return false;
+        }
+        covered += length;
+    }
+    if (covered != n) {
+        skLogE("GameGrid::deserialize: Runs cover %d cells out of %d", covered, n);
+        return false;
+    }
+
+    u32 listenerCount = 0;
+    if (!readU32(reader->read("listeners"), &listenerCount) || listenerCount > n) {
+        skLogE("GameGrid::deserialize: Invalid listener count %d", listenerCount);
+        return false;
+    }
+    listeners->resize(listenerCount * 3);
+    for (u32 &v : *listeners) {
+        if (!readU32(reader->readInner(), &v)) {
+            skLogE("GameGrid::deserialize: Truncated listeners");
+            return false;
+        }
+    }
+    return true;
+}
+
 u32 GameGrid::area() const {
     return size_.w() * size_.h();
 }
 
 const GameGrid::Cell *GameGrid::cellAt(const PositionI &p) const {
+    // Negative coordinates wrap around and fail the bounds check.
     const u32 x = p.x();
     const u32 y = p.y();
-    if (y < grid_.size()) {
-        const astl::vector<Cell> &row = grid_[y];
-        if (x < row.size()) {
-          const Cell &cell = row[x];
-            return &cell;
-        }
+    if (x < size_.w() && y < size_.h()) {
+        return cellAtUnchecked(x, y);
     }
 
     return nullptr;
 }
 
+GameGrid::CellSpan GameGrid::row(u32 y) const {
+    if (y < size_.h() && layout_ == Layout::RowMajor) {
+        return { cellAtUnchecked(0, y), size_.w() };
+    }
+    return { nullptr, 0 };
+}
+
+u32 GameGrid::allocatedChunks() const {
+    u32 count = 0;
+    for (const Chunk &chunk : chunks_) {
+        count += chunk.cells.empty() ? 0 : 1;
+    }
+    return count;
+}
+
+void GameGrid::touchChunk(Chunk &chunk, u32 cx, u32 cy) const {
+    const u32 x0 = cx << kChunkShift;
+    const u32 y0 = cy << kChunkShift;
+    const u32 x1 = skMin(x0 + kChunkSize, size_.w());
+    const u32 y1 = skMin(y0 + kChunkSize, size_.h());
+    chunk.touched = true;
+
+    // Cells only get allocated once a type differs from the first one.
+    PositionI p;
+    for (u32 y = y0; y < y1; ++y) {
+        p.y() = y;
+        if (initSpan_) {
+            initSpan_(PositionI(x0, y), initScratch_.data(), x1 - x0);
+        }
+        for (u32 x = x0; x < x1; ++x) {
+            p.x() = x;
+            const u32 type = initSpan_ ? initScratch_[x - x0] : initFunc_(p);
+            if (x == x0 && y == y0) {
+                chunk.uniformCell = { type, nullptr };
+                continue;
+            }
+            if (type == chunk.uniformCell.type) {
+                continue;
+            }
+            if (chunk.cells.empty()) {
+                chunk.cells.assign(kChunkArea, chunk.uniformCell);
+            }
+            chunk.cells[chunkCellIndex(x, y)].type = type;
+            ++chunk.nonUniform;
+        }
+    }
+    if (!typeTraits_.empty()) {
+        for (u32 y = y0; y < y1; ++y) {
+            for (u32 x = x0; x < x1; ++x) {
+                setTraitBits(tileIndex(x, y), tileBit(x, y), chunk.cells.empty() ? chunk.uniformCell.type : chunk.cells[chunkCellIndex(x, y)].type);
+            }
+        }
+    }
+}
+
+void GameGrid::materializeChunk(Chunk &chunk) {
+    if (chunk.cells.empty()) {
+        chunk.cells.assign(kChunkArea, chunk.uniformCell);
+    }
+}
+
+u32 GameGrid::chunkCellCount(u32 cx, u32 cy) const {
+    const u32 x0 = cx << kChunkShift;
+    const u32 y0 = cy << kChunkShift;
+    return (skMin(x0 + kChunkSize, size_.w()) - x0) * (skMin(y0 + kChunkSize, size_.h()) - y0);
+}
+
+void GameGrid::rebaseChunk(Chunk &chunk, u32 cx, u32 cy, u32 type) {
+    const u32 x0 = cx << kChunkShift;
+    const u32 y0 = cy << kChunkShift;
+    const u32 x1 = skMin(x0 + kChunkSize, size_.w());
+    const u32 y1 = skMin(y0 + kChunkSize, size_.h());
+    for (u32 y = y0; y < y1; ++y) {
+        for (u32 x = x0; x < x1; ++x) {
+            if (chunk.cells[chunkCellIndex(x, y)].type != type) {
+                return;
+            }
+        }
+    }
+    // Rewritten wholesale to another type, that type becomes the uniform one.
+    chunk.uniformCell.type = type;
+    chunk.nonUniform = 0;
+}
+
+void GameGrid::releaseChunkIfUnused(Chunk &chunk) {
+    if (!chunk.cells.empty() && chunk.occupied == 0 && chunk.nonUniform == 0) {
+        astl::vector<Cell>().swap(chunk.cells);
+    }
+}
+
+void GameGrid::setOccupant(u32 x, u32 y, Listener *ggl) {
+    Cell *c = rwCellAtUnchecked(x, y);
+    if (journalEnabled_ && c->data != ggl) {
+        journalCell(x, y, kCellOccupantChanged);
+    }
+    if (layout_ == Layout::Chunked) {
+        Chunk &chunk = chunkAt(x, y);
+        if (!c->data && ggl) {
+            ++chunk.occupied;
+        }
+        else if (c->data && !ggl) {
+            --chunk.occupied;
+        }
+        c->data = ggl;
+        releaseChunkIfUnused(chunk);
+    }
+    else {
+        c->data = ggl;
+    }
+    const u32 tile = tileIndex(x, y);
+    u64 &mask = occupancy_[tile];
+    if (ggl) {
+        mask |= tileBit(x, y);
+    }
+    else {
+        mask &= ~tileBit(x, y);
+    }
+    tileRevisions_[tile].occupancy = ++revision_;
+}
+
+void GameGrid::setType(u32 x, u32 y, u32 type) {
+    if (cellAtUnchecked(x, y)->type == type) {
+        return;
+    }
+    storeType(x, y, type);
+    typesChanged(tileIndex(x, y), tileBit(x, y), type);
+}
+
+void GameGrid::storeType(u32 x, u32 y, u32 type) {
+    Cell *c = rwCellAtUnchecked(x, y);
+    if (layout_ == Layout::Chunked) {
+        Chunk &chunk = chunkAt(x, y);
+        const u32 uniformType = chunk.uniformCell.type;
+        bool allDiffer = false;
+        if (c->type == uniformType) {
+            allDiffer = ++chunk.nonUniform == chunkCellCount(x >> kChunkShift, y >> kChunkShift);
+        }
+        else if (type == uniformType) {
+            --chunk.nonUniform;
+        }
+        c->type = type;
+        if (allDiffer) {
+            rebaseChunk(chunk, x >> kChunkShift, y >> kChunkShift, type);
+        }
+        releaseChunkIfUnused(chunk);
+    }
+    else {
+        c->type = type;
+    }
+}
+
+void GameGrid::typesChanged(u32 tile, u64 bits, u32 type) {
+    tileRevisions_[tile].type = ++revision_;
+    if (!typeTraits_.empty()) {
+        setTraitBits(tile, bits, type);
+    }
+    if (journalEnabled_) {
+        journalTile(tile, bits, 0);
+    }
+}
+
+void GameGrid::setTypeTraits(u32 type, u32 traits) {
+    if (type < typeTraits_.size() && typeTraits_[type] == traits) {
+        return;
+    }
+    if (type >= typeTraits_.size()) {
+        typeTraits_.resize(type + 1, 0);
+    }
+    typeTraits_[type] = traits;
+    rebuildTraitPlanes();
+}
+
+void GameGrid::setTypeTraits(const u32 *traits, u32 count) {
+    typeTraits_.assign(traits, traits + count);
+    rebuildTraitPlanes();
+}
+
+void GameGrid::setTraitBits(u32 tile, u64 bits, u32 type) const {
+    const u32 traits = typeTraits(type);
+    const u32 tiles = tilesW_ * tilesH_;
+    skLoop(plane, kTraitPlaneCount) {
+        u64 &mask = traitPlanes_[plane * tiles + tile];
+        mask = (traits & (1u << plane)) ? (mask | bits) : (mask & ~bits);
+    }
+}
+
+void GameGrid::rebuildTraitPlanes() {
+    traitPlanes_.assign(typeTraits_.empty() ? 0 : kTraitPlaneCount * tilesW_ * tilesH_, 0);
+    if (typeTraits_.empty()) {
+        return;
+    }
+    const u32 w = size_.w();
+    const u32 h = size_.h();
+    if (layout_ != Layout::Chunked) {
+        skLoop(y, h) {
+            skLoop(x, w) {
+                setTraitBits(tileIndex(x, y), tileBit(x, y), cells_[cellIndex(x, y)].type);
+            }
+        }
+        return;
+    }
+    // Untouched chunks get their planes once first accessed.
+    skLoop(cy, chunks_.size() / chunksW_) {
+        skLoop(cx, chunksW_) {
+            const Chunk &chunk = chunks_[cy * chunksW_ + cx];
+            if (!chunk.touched) {
+                continue;
+            }
+            const u32 x0 = cx << kChunkShift;
+            const u32 y0 = cy << kChunkShift;
+            const u32 x1 = skMin(x0 + kChunkSize, w);
+            const u32 y1 = skMin(y0 + kChunkSize, h);
+            for (u32 y = y0; y < y1; ++y) {
+                for (u32 x = x0; x < x1; ++x) {
+                    setTraitBits(tileIndex(x, y), tileBit(x, y), chunk.cells.empty() ? chunk.uniformCell.type : chunk.cells[chunkCellIndex(x, y)].type);
+                }
+            }
+        }
+    }
+}
+
+bool GameGrid::setCellType(const PositionI &p, u32 type) {
+    if (!cellAt(p)) {
+        return false;
+    }
+    setType(p.x(), p.y(), type);
+    return true;
+}
+
+bool GameGrid::changedSince(u32 revision, const PositionI &a, const PositionI &b, bool includeOccupancy) const {
+    const i32 x0 = skMax(skMin(a.x(), b.x()), 0);
+    const i32 y0 = skMax(skMin(a.y(), b.y()), 0);
+    const i32 x1 = skMin(skMax(a.x(), b.x()), static_cast<i32>(size_.w()) - 1);
+    const i32 y1 = skMin(skMax(a.y(), b.y()), static_cast<i32>(size_.h()) - 1);
+    if (x0 > x1 || y0 > y1 || revision == revision_) {
+        return false;
+    }
+    for (u32 ty = y0 >> kTileShift; ty <= static_cast<u32>(y1) >> kTileShift; ++ty) {
+        for (u32 tx = x0 >> kTileShift; tx <= static_cast<u32>(x1) >> kTileShift; ++tx) {
+            const TileRevision &tr = tileRevisions_[ty * tilesW_ + tx];
+            if (tr.type > revision || (includeOccupancy && tr.occupancy > revision)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void GameGrid::setJournalEnabled(bool enabled) {
+    journalEnabled_ = enabled;
+    const u32 tiles = tilesW_ * tilesH_;
+    dirtyTiles_.assign(enabled ? tiles : 0, { 0, 0 });
+    dirtyTileBits_.assign(enabled ? (tiles + 63) >> 6 : 0, 0);
+    dirtyTileList_.clear();
+    journalMoved_.clear();
+    ++journalTick_;
+}
+
+void GameGrid::journalCell(u32 x, u32 y, u8 flags) {
+    const u64 bit = tileBit(x, y);
+    journalTile(tileIndex(x, y), (flags & kCellTypeChanged) ? bit : 0, (flags & kCellOccupantChanged) ? bit : 0);
+}
+
+void GameGrid::journalTile(u32 tile, u64 typeBits, u64 occupantBits) {
+    DirtyTile &dirty = dirtyTiles_[tile];
+    if (!dirty.type && !dirty.occupant) {
+        dirtyTileList_.push_back(tile);
+        dirtyTileBits_[tile >> 6] |= 1ull << (tile & 63);
+    }
+    dirty.type |= typeBits;
+    dirty.occupant |= occupantBits;
+}
+
+void GameGrid::journalMoved(Listener *ggl) {
+    if (journalEnabled_ && ggl->journalStamp_ != journalTick_) {
+        ggl->journalStamp_ = journalTick_;
+        ggl->journalSlot_ = journalMoved_.size();
+        journalMoved_.push_back(ggl);
+    }
+}
+
+void GameGrid::notify(Listener *ggl, EventKind kind, const PositionI &p, u32 result) {
+    if (deferredEvents_) {
+        events_.push_back({ ggl, p, result, 0, kind });
+        return;
+    }
+    deliver(ggl, kind, p, result);
+}
+
+void GameGrid::deliver(Listener *ggl, EventKind kind, const PositionI &p, u32 result) {
+    switch (kind) {
+    case EventKind::Entered:
+        ggl->onGridEntered(this);
+        break;
+    case EventKind::Left:
+        ggl->onGridLeft(this);
+        break;
+    case EventKind::Moved:
+        ggl->onGridMoved(p, result);
+        break;
+    case EventKind::Rejected:
+        ggl->onGridMoveRejected(result);
+        break;
+    }
+}
+
+void GameGrid::setDeferredEvents(bool deferred) {
+    if (deferredEvents_ == deferred) {
+        return;
+    }
+    if (!deferred) {
+        dispatchEvents();
+    }
+    deferredEvents_ = deferred;
+}
+
+u32 GameGrid::dispatchEvents() {
+    if (dispatching_ || events_.empty()) {
+        return 0;
+    }
+    // Events raised by the callbacks go to the next dispatch.
+    dispatching_ = true;
+    dispatched_.swap(events_);
+    events_.clear();
+
+    if (++dispatchTick_ == 0) {
+        dispatchTick_ = 1;
+    }
+    u32 groups = 0;
+    for (Event &e : dispatched_) {
+        Listener *ggl = e.listener;
+        if (ggl->eventStamp_ != dispatchTick_) {
+            ggl->eventStamp_ = dispatchTick_;
+            ggl->eventGroup_ = groups++;
+        }
+        e.group = ggl->eventGroup_;
+    }
+    astl::stable_sort(dispatched_.begin(), dispatched_.end(),
+        [](const Event &a, const Event &b) { return a.group < b.group; });
+
+    for (const Event &e : dispatched_) {
+        deliver(e.listener, e.kind, e.position, e.result);
+    }
+    dispatching_ = false;
+    const u32 count = dispatched_.size();
+    dispatched_.clear();
+    return count;
+}
+
+void GameGrid::addListener(Listener *ggl) {
+    ggl->grid_ = this;
+    ggl->slot_ = listeners_.size();
+    listeners_.push_back(ggl);
+}
+
+void GameGrid::removeListener(Listener *ggl) {
+    Listener *last = listeners_.back();
+    listeners_[ggl->slot_] = last;
+    last->slot_ = ggl->slot_;
+    listeners_.pop_back();
+    ggl->slot_ = astl::numeric_limits<u32>::max();
+    if (ggl->journalStamp_ == journalTick_) {
+        Listener *lastMoved = journalMoved_.back();
+        journalMoved_[ggl->journalSlot_] = lastMoved;
+        lastMoved->journalSlot_ = ggl->journalSlot_;
+        journalMoved_.pop_back();
+        ggl->journalStamp_ = 0;
+    }
+}
+
+void GameGrid::drainJournal(Journal &journal) {
+    journal.cells.clear();
+    journal.moved.clear();
+    journal.tilesW = tilesW_;
+    journal.tilesH = tilesH_;
+    journal.dirtyTiles.swap(dirtyTileBits_);
+    dirtyTileBits_.assign(journal.dirtyTiles.size(), 0);
+    journal.moved.swap(journalMoved_);
+    ++journalTick_;
+
+    astl::sort(dirtyTileList_.begin(), dirtyTileList_.end());
+    for (const u32 tile : dirtyTileList_) {
+        DirtyTile &dirty = dirtyTiles_[tile];
+        const u32 baseX = (tile % tilesW_) << kTileShift;
+        const u32 baseY = (tile / tilesW_) << kTileShift;
+        u64 mask = dirty.type | dirty.occupant;
+        while (mask) {
+            const u32 bit = skLowestBit64(mask);
+            const u64 cellBit = mask & (0 - mask);
+            mask &= mask - 1;
+            const u8 flags = ((dirty.type & cellBit) ? kCellTypeChanged : 0)
+                | ((dirty.occupant & cellBit) ? kCellOccupantChanged : 0);
+            journal.cells.push_back({ baseX + (bit & kTileMask), baseY + (bit >> kTileShift), flags });
+        }
+        dirty = { 0, 0 };
+    }
+    dirtyTileList_.clear();
+}
+
+void GameGrid::fillTypes(u32 begin, u32 end, u32 type) {
+    const u32 w = size_.w();
+    const u32 h = size_.h();
+    const u32 y0 = begin / w;
+    const u32 x0 = begin - y0 * w;
+    const u32 y1 = (end - 1) / w;
+    const u32 x1 = (end - 1) - y1 * w;
+
+    // Uniform chunks covered whole only change their uniform type,
+    // without allocating their cells.
+    if (layout_ == Layout::Chunked) {
+        for (u32 cy = y0 >> kChunkShift; cy <= y1 >> kChunkShift; ++cy) {
+            skLoop(cx, chunksW_) {
+                const u32 cx0 = cx << kChunkShift;
+                const u32 cy0 = cy << kChunkShift;
+                const u32 cx1 = skMin(cx0 + kChunkMask, w - 1);
+                const u32 cy1 = skMin(cy0 + kChunkMask, h - 1);
+                if (cy0 * w + cx0 < begin || cy1 * w + cx1 >= end) {
+                    continue;
+                }
+                Chunk &chunk = chunks_[cy * chunksW_ + cx];
+                if (!chunk.touched) {
+                    touchChunk(chunk, cx, cy);
+                }
+                if (!chunk.cells.empty() || chunk.uniformCell.type == type) {
+                    continue;
+                }
+                chunk.uniformCell.type = type;
+                for (u32 ty = cy0 >> kTileShift; ty <= cy1 >> kTileShift; ++ty) {
+                    for (u32 tx = cx0 >> kTileShift; tx <= cx1 >> kTileShift; ++tx) {
+                        const u32 bx = tx << kTileShift;
+                        const u32 by = ty << kTileShift;
+                        typesChanged(ty * tilesW_ + tx, GridTiles::tileAreaMask(0, 0, skMin(w - 1 - bx, kTileMask), skMin(h - 1 - by, kTileMask)), type);
+                    }
+                }
+            }
+        }
+    }
+
+    // Band of tiles by band of tiles, so that each tile is recorded once.
+    for (u32 ty = y0 >> kTileShift; ty <= y1 >> kTileShift; ++ty) {
+        const u32 rowBegin = skMax(y0, ty << kTileShift);
+        const u32 rowEnd = skMin(y1, (ty << kTileShift) + kTileMask);
+        const u32 bandX0 = rowBegin == rowEnd && rowBegin == y0 ? x0 : 0;
+        const u32 bandX1 = rowBegin == rowEnd && rowEnd == y1 ? x1 : w - 1;
+        for (u32 tx = bandX0 >> kTileShift; tx <= bandX1 >> kTileShift; ++tx) {
+            const u32 tileX0 = tx << kTileShift;
+            const u32 tileX1 = skMin(tileX0 + kTileMask, w - 1);
+            u64 changed = 0;
+            for (u32 y = rowBegin; y <= rowEnd; ++y) {
+                const u32 rowX0 = y == y0 ? x0 : 0;
+                const u32 rowX1 = y == y1 ? x1 : w - 1;
+                const u32 from = skMax(tileX0, rowX0);
+                const u32 to = skMin(tileX1, rowX1);
+                for (u32 x = from; x <= to; ++x) {
+                    if (cellAtUnchecked(x, y)->type != type) {
+                        storeType(x, y, type);
+                        changed |= tileBit(x, y);
+                    }
+                }
+            }
+            if (changed) {
+                typesChanged(ty * tilesW_ + tx, changed, type);
+            }
+        }
+    }
+}
+
+template <typename Pred>
+u32 GameGrid::queryTiles(u32 x0, u32 y0, u32 x1, u32 y1, Pred pred, Listener **out, u32 capacity) const {
+    u32 count = 0;
+    const u32 stamp = ++queryStamp_;
+    GridTiles::forEachCell(occupancy_.data(), tilesW_, x0, y0, x1, y1, [&](u32 x, u32 y) {
+        if (!pred(static_cast<i32>(x), static_cast<i32>(y))) {
+            return true;
+        }
+        Listener *ggl = cellAtUnchecked(x, y)->data;
+        if (!isSingleCell(ggl->footprint_)) {
+            if (ggl->queryStamp_ == stamp) {
+                return true;
+            }
+            ggl->queryStamp_ = stamp;
+        }
+        if (count >= capacity) {
+            return false;
+        }
+        out[count++] = ggl;
+        return true;
+    });
+    return count;
+}
+
+u32 GameGrid::queryRect(const PositionI &a, const PositionI &b, Listener **out, u32 capacity) const {
+    const i32 x0 = skMax(skMin(a.x(), b.x()), 0);
+    const i32 y0 = skMax(skMin(a.y(), b.y()), 0);
+    const i32 x1 = skMin(skMax(a.x(), b.x()), static_cast<i32>(size_.w()) - 1);
+    const i32 y1 = skMin(skMax(a.y(), b.y()), static_cast<i32>(size_.h()) - 1);
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+    return queryTiles(x0, y0, x1, y1, [](i32, i32) { return true; }, out, capacity);
+}
+
+u32 GameGrid::queryRadius(const PositionI &center, u32 radius, Listener **out, u32 capacity) const {
+    const i32 r = static_cast<i32>(radius);
+    const i32 cx = center.x();
+    const i32 cy = center.y();
+    const i32 x0 = skMax(cx - r, 0);
+    const i32 y0 = skMax(cy - r, 0);
+    const i32 x1 = skMin(cx + r, static_cast<i32>(size_.w()) - 1);
+    const i32 y1 = skMin(cy + r, static_cast<i32>(size_.h()) - 1);
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+    // round(sqrt(d2)) <= r <=> d2 < (r + 0.5)^2 <=> d2 <= r^2 + r
+    const i64 maxDistSq = static_cast<i64>(r) * r + r;
+    return queryTiles(x0, y0, x1, y1, [=](i32 x, i32 y) {
+        const i64 dx = x - cx;
+        const i64 dy = y - cy;
+        return dx * dx + dy * dy <= maxDistSq;
+    }, out, capacity);
+}
+
+u32 GameGrid::queryCone(const PositionI &origin, const Array2I &direction, u32 range, f32 halfAngle, Listener **out, u32 capacity) const {
+    const f32 dirLen = ni::Sqrt(static_cast<f32>(direction[0] * direction[0] + direction[1] * direction[1]));
+    if (dirLen == 0.0f) {
+        return 0;
+    }
+    const f32 dirX = direction[0] / dirLen;
+    const f32 dirY = direction[1] / dirLen;
+    const f32 cosHalf = cosf(halfAngle);
+    const i32 r = static_cast<i32>(range);
+    const i32 ox = origin.x();
+    const i32 oy = origin.y();
+    const i32 x0 = skMax(ox - r, 0);
+    const i32 y0 = skMax(oy - r, 0);
+    const i32 x1 = skMin(ox + r, static_cast<i32>(size_.w()) - 1);
+    const i32 y1 = skMin(oy + r, static_cast<i32>(size_.h()) - 1);
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+    const i64 maxDistSq = static_cast<i64>(r) * r + r;
+    return queryTiles(x0, y0, x1, y1, [=](i32 x, i32 y) {
+        const i64 dx = x - ox;
+        const i64 dy = y - oy;
+        const i64 distSq = dx * dx + dy * dy;
+        if (distSq == 0 || distSq > maxDistSq) {
+            return false;
+        }
+        // Compare cos(angle) against cos(halfAngle) without normalizing d.
+        const f32 dot = dx * dirX + dy * dirY;
+        return dot >= cosHalf * ni::Sqrt(static_cast<f32>(distSq)) - skEpsilonL;
+    }, out, capacity);
+}
+
+void GameGrid::setBlocksSight(blocksSightFunc func) {
+    blocksSight_ = func;
+    sightCache_.clear();
+    if (blocksSight_) {
+        sightCache_.resize(kSightCacheSize);
+        skLoop(type, kSightCacheSize) {
+            sightCache_[type] = blocksSight_(type) ? 1 : 0;
+        }
+    }
+}
+
+bool GameGrid::hasLineOfSight(const PositionI &from, const PositionI &to) const {
+    if (!cellAt(from) || !cellAt(to)) {
+        return false;
+    }
+    if ((!blocksSight_ && typeTraits_.empty()) || from == to) {
+        return true;
+    }
+
+    // Always trace from the lowest end so both directions
+    // walk the exact same cells.
+    PositionI a = from;
+    PositionI b = to;
+    if (b.y() < a.y() || (b.y() == a.y() && b.x() < a.x())) {
+        astl::swap(a, b);
+    }
+
+    // Bresenham, end cells excluded.
+    const i32 dx = ni::Abs(b.x() - a.x());
+    const i32 dy = -ni::Abs(b.y() - a.y());
+    const i32 sx = a.x() < b.x() ? 1 : -1;
+    const i32 sy = a.y() < b.y() ? 1 : -1;
+    i32 err = dx + dy;
+    i32 x = a.x();
+    i32 y = a.y();
+    for (;;) {
+        const i32 e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y += sy;
+        }
+        if (x == b.x() && y == b.y()) {
+            return true;
+        }
+        if (blocksSight(x, y)) {
+            return false;
+        }
+    }
+}
+
 bool GameGrid::leave(GameGrid::Listener *ggl) {
     if (ggl->currentGrid() == this) {
         const PositionI p = ggl->position();
-        Cell *c = const_cast<Cell *>(cellAt(p));
+        const Cell *c = cellAt(p);
         if (c == nullptr) {
             skUnreachable("Couldn't find cell at position(%d,%d)", p.x(), p.y());
             return false;
         }
-        skFindEraseUnordered(listeners_, ggl);
-        ggl->onGridLeft(this);
+        removeListener(ggl);
+        notify(ggl, EventKind::Left, p, 0);
         ggl->setPosition(PositionI::undefined());
         ggl->grid_ = nullptr;
-        c->data = nullptr;
+        stampFootprint(p, ggl->footprint_, nullptr, p, { 0, 0 });
         return true;
     }
     return false;
 }
 
-u32 GameGrid::move(GameGrid::Listener *ggl, const PositionI &p) {
+u32 GameGrid::leaveMany(Listener *const *ggls, u32 count) {
+    u32 left = 0;
+    skLoop(i, count) {
+        if (leave(ggls[i])) {
+            ++left;
+        }
+    }
+    return left;
+}
+
+u32 GameGrid::validateFootprint(Listener *ggl, const PositionI &p, const SizeU &fp) {
     const u32 ret = validator_->validateMove(this, ggl, p);
-    if (!validator_->isError(ret)) {
-        if (!ggl->currentGrid()) {
-            ggl->grid_ = this;
-            ggl->onGridEntered(this);
-            listeners_.push_back(ggl);
+    if (validator_->isError(ret) || isSingleCell(fp)) {
+        return ret;
+    }
+    skLoop(dy, fp.h()) {
+        skLoop(dx, fp.w()) {
+            if (dx == 0 && dy == 0) {
+                continue;
+            }
+            const u32 cellRet = validator_->validateMove(this, ggl, { p.x() + dx, p.y() + dy });
+            if (validator_->isError(cellRet)) {
+                return cellRet;
+            }
         }
-        Cell *prevCell = const_cast<Cell *>(cellAt(ggl->position()));
-        if (prevCell) {
-            prevCell->data = nullptr;
+    }
+    return ret;
+}
+
+void GameGrid::stampFootprint(const PositionI &p, const SizeU &fp, Listener *ggl, const PositionI &skip, const SizeU &skipFp) {
+    const i32 sx0 = skip.x();
+    const i32 sy0 = skip.y();
+    const i32 sx1 = sx0 + static_cast<i32>(skipFp.w());
+    const i32 sy1 = sy0 + static_cast<i32>(skipFp.h());
+    const i32 x0 = p.x();
+    const i32 x1 = x0 + static_cast<i32>(fp.w());
+    const i32 y1 = p.y() + static_cast<i32>(fp.h());
+    for (i32 y = p.y(); y < y1; ++y) {
+        const bool skipRow = y >= sy0 && y < sy1;
+        for (i32 x = x0; x < x1; ++x) {
+            if (skipRow && x >= sx0 && x < sx1) {
+                // Jump past the overlapping span.
+                x = sx1 - 1;
+                continue;
+            }
+            setOccupant(x, y, ggl);
+        }
+    }
+}
+
+bool GameGrid::placeFootprint(Listener *ggl, const PositionI &p, const SizeU &fp) {
+    const bool entered = !ggl->currentGrid();
+    if (entered) {
+        addListener(ggl);
+    }
+    // Occupy the new cells first so a chunk being
+    // moved within does not get released in between.
+    const PositionI prev = ggl->position();
+    const SizeU prevFp = ggl->footprint_;
+    if (entered) {
+        stampFootprint(p, fp, ggl, p, { 0, 0 });
+    }
+    else {
+        stampFootprint(p, fp, ggl, prev, prevFp);
+        stampFootprint(prev, prevFp, nullptr, p, fp);
+    }
+    ggl->footprint_ = fp;
+    ggl->setPosition(p);
+    if (entered || prev != p) {
+        journalMoved(ggl);
+    }
+    return entered;
+}
+
+u32 GameGrid::move(GameGrid::Listener *ggl, const PositionI &p) {
+    const SizeU fp = footprintOf(ggl);
+    const u32 ret = validateFootprint(ggl, p, fp);
+    if (!validator_->isError(ret)) {
+        if (placeFootprint(ggl, p, fp)) {
+            notify(ggl, EventKind::Entered, p, ret);
         }
-        const_cast<Cell *>(cellAt(p))->data = ggl;
-        ggl->setPosition(p);
-        ggl->onGridMoved(p, ret);
+        notify(ggl, EventKind::Moved, p, ret);
     }
     else {
-        ggl->onGridMoveRejected(ret);
+        notify(ggl, EventKind::Rejected, p, ret);
     }
     return ret;
 }
 
+u32 GameGrid::enterMany(MoveRequest *requests, u32 count) {
+    listeners_.reserve(listeners_.size() + count);
+    u32 accepted = 0;
+    skLoop(i, count) {
+        MoveRequest &req = requests[i];
+        req.result = move(req.listener, req.target);
+        if (!validator_->isError(req.result)) {
+            ++accepted;
+        }
+    }
+    return accepted;
+}
+
+static constexpr u32 kNoBatch = astl::numeric_limits<u32>::max();
+
+u32 GameGrid::moveBatch(MoveRequest *requests, u32 count, bool allowSwaps) {
+    const u32 w = size_.w();
+    batch_.resize(count);
+    batchOrder_.resize(count);
+
+    // Movers' cells are seen as free while validating.
+    skLoop(i, count) {
+        MoveRequest &req = requests[i];
+        Listener *ggl = req.listener;
+        BatchEntry &e = batch_[i];
+        const PositionI prev = ggl->position();
+        const bool onGrid = ggl->currentGrid() == this && cellAt(prev);
+        e.dependent = kNoBatch;
+        e.entered = false;
+        e.large = !isSingleCell(footprintOf(ggl)) || (onGrid && !isSingleCell(ggl->footprint_));
+        if (e.large) {
+            e.source = kNoBatch;
+            continue;
+        }
+        ggl->batchIndex_ = i;
+        e.source = onGrid ? prev.y() * w + prev.x() : kNoBatch;
+        if (onGrid) {
+            rwCellAtUnchecked(prev.x(), prev.y())->data = nullptr;
+        }
+    }
+    skLoop(i, count) {
+        MoveRequest &req = requests[i];
+        BatchEntry &e = batch_[i];
+        batchOrder_[i] = i;
+        if (e.large) {
+            e.accepted = false;
+            e.target = kNoBatch;
+            e.priority = 0;
+            continue;
+        }
+        req.result = validator_->validateMove(this, req.listener, req.target);
+        e.accepted = !validator_->isError(req.result) && cellAt(req.target);
+        e.target = e.accepted ? req.target.y() * w + req.target.x() : kNoBatch;
+        // Staying put beats moving in, then row-major order, then newcomers.
+        e.priority = e.target == e.source ? 0 : (e.source != kNoBatch ? 1 + e.source : 1 + area() + i);
+    }
+    skLoop(i, count) {
+        const BatchEntry &e = batch_[i];
+        if (e.source != kNoBatch) {
+            rwCellAtUnchecked(e.source % w, e.source / w)->data = requests[i].listener;
+        }
+    }
+
+    // One winner per claimed cell.
+    astl::sort(batchOrder_.begin(), batchOrder_.end(), [this](u32 a, u32 b) {
+        const BatchEntry &ea = batch_[a];
+        const BatchEntry &eb = batch_[b];
+        return ea.target < eb.target || (ea.target == eb.target && ea.priority < eb.priority);
+    });
+    for (u32 k = 1; k < count; ++k) {
+        BatchEntry &e = batch_[batchOrder_[k]];
+        if (e.accepted && e.target == batch_[batchOrder_[k - 1]].target) {
+            e.accepted = false;
+            requests[batchOrder_[k]].result = kMoveConflict;
+        }
+    }
+
+    // Winners moving into an occupied cell depend on its occupant leaving.
+    skLoop(i, count) {
+        BatchEntry &e = batch_[i];
+        if (!e.accepted || e.target == e.source) {
+            continue;
+        }
+        const Listener *occupant = cellAtUnchecked(e.target % w, e.target / w)->data;
+        if (!occupant) {
+            continue;
+        }
+        // Both sides of a swap get rejected here when not allowed.
+        const u32 j = occupant->batchIndex_;
+        if (j == kNoBatch || (!allowSwaps && batch_[j].target == e.source)) {
+            e.accepted = false;
+            requests[i].result = kMoveConflict;
+        }
+        else {
+            batch_[j].dependent = i;
+        }
+    }
+
+    // Rejections propagate down the chains.
+    skLoop(i, count) {
+        if (batch_[i].accepted) {
+            continue;
+        }
+        for (u32 d = batch_[i].dependent; d != kNoBatch && batch_[d].accepted; d = batch_[d].dependent) {
+            batch_[d].accepted = false;
+            requests[d].result = kMoveConflict;
+        }
+    }
+
+    // Commit, clearing every source before filling the targets.
+    u32 accepted = 0;
+    skLoop(i, count) {
+        const BatchEntry &e = batch_[i];
+        if (e.accepted && e.source != kNoBatch && e.source != e.target) {
+            setOccupant(e.source % w, e.source / w, nullptr);
+        }
+    }
+    skLoop(i, count) {
+        BatchEntry &e = batch_[i];
+        MoveRequest &req = requests[i];
+        Listener *ggl = req.listener;
+        ggl->batchIndex_ = kNoBatch;
+        if (!e.accepted) {
+            continue;
+        }
+        ++accepted;
+        if (!ggl->currentGrid()) {
+            addListener(ggl);
+            e.entered = true;
+        }
+        setOccupant(req.target.x(), req.target.y(), ggl);
+        ggl->footprint_ = { 1, 1 };
+        ggl->setPosition(req.target);
+        if (e.target != e.source) {
+            journalMoved(ggl);
+        }
+    }
+
+    // Larger listeners, against the settled cells.
+    skLoop(i, count) {
+        BatchEntry &e = batch_[i];
+        if (!e.large) {
+            continue;
+        }
+        MoveRequest &req = requests[i];
+        const SizeU fp = footprintOf(req.listener);
+        req.result = validateFootprint(req.listener, req.target, fp);
+        if (!validator_->isError(req.result)) {
+            e.entered = placeFootprint(req.listener, req.target, fp);
+            e.accepted = true;
+            ++accepted;
+        }
+    }
+
+    // Deliver the callbacks in a single sweep.
+    skLoop(i, count) {
+        const MoveRequest &req = requests[i];
+        Listener *ggl = req.listener;
+        if (batch_[i].accepted) {
+            if (batch_[i].entered) {
+                notify(ggl, EventKind::Entered, req.target, req.result);
+            }
+            notify(ggl, EventKind::Moved, req.target, req.result);
+        }
+        else {
+            notify(ggl, EventKind::Rejected, req.target, req.result);
+        }
+    }
+    return accepted;
+}
+
 }; }; // namespace spark::game
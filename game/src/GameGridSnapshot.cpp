@@ -0,0 +1,125 @@
+#include <GameGridSnapshot.hpp>
+
+namespace spark {
+using namespace common;
+using namespace common::math;
+namespace game {
+
+GameGridSnapshot::GameGridSnapshot(const GameGrid *grid, walkableFunc func)
+    : grid_(grid)
+    , walkableFunc_(func)
+    , revision_(grid->revision())
+    , tilesW_((grid->size().w() + GameGrid::kTileMask) >> GameGrid::kTileShift) {
+}
+
+const GameGrid::Cell *GameGridSnapshot::cellAtUnchecked(u32 x, u32 y) const {
+    auto it = pages_.find(tileIndex(x, y));
+    if (it == pages_.end()) {
+        return grid_->cellAtUnchecked(x, y);
+    }
+    return &it->second->cells[pageIndex(x, y)];
+}
+
+const GameGrid::Cell *GameGridSnapshot::cellAt(const PositionI &p) const {
+    return contains(p.x(), p.y()) ? cellAtUnchecked(p.x(), p.y()) : nullptr;
+}
+
+GameGrid::Cell *GameGridSnapshot::writableCell(u32 x, u32 y) {
+    astl::shared_ptr<Page> &page = pages_[tileIndex(x, y)];
+    if (!page) {
+        // First write to the tile, copy it from the grid.
+        page = astl::make_shared<Page>();
+        const u32 baseX = x & ~GameGrid::kTileMask;
+        const u32 baseY = y & ~GameGrid::kTileMask;
+        const u32 w = skMin(GameGrid::kTileSize, grid_->size().w() - baseX);
+        const u32 h = skMin(GameGrid::kTileSize, grid_->size().h() - baseY);
+        skLoop(ly, h) {
+            skLoop(lx, w) {
+                page->cells[pageIndex(lx, ly)] = *grid_->cellAtUnchecked(baseX + lx, baseY + ly);
+            }
+        }
+    }
+    else if (page.use_count() > 1) {
+        // Shared with another snapshot.
+        page = astl::make_shared<Page>(*page);
+    }
+    return &page->cells[pageIndex(x, y)];
+}
+
+bool GameGridSnapshot::setCellType(const PositionI &p, u32 type) {
+    if (!contains(p.x(), p.y())) {
+        return false;
+    }
+    if (cellAtUnchecked(p.x(), p.y())->type != type) {
+        writableCell(p.x(), p.y())->type = type;
+    }
+    return true;
+}
+
+bool GameGridSnapshot::placement(const GameGrid::Listener *ggl, Placement *out) const {
+    auto it = placements_.find(ggl);
+    if (it != placements_.end()) {
+        *out = it->second;
+        return contains(out->position.x(), out->position.y());
+    }
+    if (ggl->currentGrid() != grid_) {
+        return false;
+    }
+    *out = { ggl->position(), ggl->footprint() };
+    return true;
+}
+
+PositionI GameGridSnapshot::position(const GameGrid::Listener *ggl) const {
+    Placement current;
+    return placement(ggl, &current) ? current.position : PositionI::undefined();
+}
+
+bool GameGridSnapshot::move(GameGrid::Listener *ggl, const PositionI &p) {
+    const SizeU size = ggl->size();
+    const SizeU fp = { skMax(size.w(), 1u), skMax(size.h(), 1u) };
+    skLoop(dy, fp.h()) {
+        skLoop(dx, fp.w()) {
+            const i32 x = p.x() + dx;
+            const i32 y = p.y() + dy;
+            if (!contains(x, y)) {
+                return false;
+            }
+            const GameGrid::Cell *c = cellAtUnchecked(x, y);
+            if ((c->data && c->data != ggl) || (walkableFunc_ && !walkableFunc_(*c))) {
+                return false;
+            }
+        }
+    }
+
+    Placement prev;
+    if (placement(ggl, &prev)) {
+        skLoop(dy, prev.footprint.h()) {
+            skLoop(dx, prev.footprint.w()) {
+                writableCell(prev.position.x() + dx, prev.position.y() + dy)->data = nullptr;
+            }
+        }
+    }
+    skLoop(dy, fp.h()) {
+        skLoop(dx, fp.w()) {
+            writableCell(p.x() + dx, p.y() + dy)->data = ggl;
+        }
+    }
+    placements_[ggl] = { p, fp };
+    return true;
+}
+
+bool GameGridSnapshot::leave(GameGrid::Listener *ggl) {
+    Placement prev;
+    if (!placement(ggl, &prev)) {
+        return false;
+    }
+    skLoop(dy, prev.footprint.h()) {
+        skLoop(dx, prev.footprint.w()) {
+            writableCell(prev.position.x() + dx, prev.position.y() + dy)->data = nullptr;
+        }
+    }
+    placements_[ggl] = { PositionI::undefined(), { 0, 0 } };
+    return true;
+}
+
+}; }; // namespace spark::game
@@ -82,6 +82,10 @@ Skill::CastError GameObject::canCastSkillImpl(Skill **skillPPtr, u32 index, Posi
     if (distance > skill->range()) {
         return Skill::CastError::OutOfRange;
     }
+    const GameGrid *grid = currentGrid();
+    if (grid && !grid->hasLineOfSight(position(), target)) {
+        return Skill::CastError::OutOfSight;
+    }
 
     *skillPPtr = skill;
     return Skill::CastError::OK;
@@ -0,0 +1,1004 @@
+#include <GamePathfinding.hpp>
+
+namespace spark {
+using namespace common;
+using namespace common::math;
+namespace game {
+
+constexpr u32 CellCosts::kDefaultTypeCost;
+constexpr u32 Pathfinder::kStraightCost;
+constexpr u32 Pathfinder::kDiagonalCost;
+constexpr u32 Pathfinder::kNone;
+constexpr u32 FlowField::kUnreachable;
+constexpr u8 FlowField::kNoDir;
+constexpr u32 HierarchicalPathfinder::kDefaultClusterSize;
+constexpr u32 HierarchicalPathfinder::kWideEntrance;
+constexpr u32 HierarchicalPathfinder::kNone;
+
+static const i32 kDirs[8][2] = {
+    { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+    { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 }
+};
+
+static inline i32 skSign(i32 v) {
+    return (v > 0) - (v < 0);
+}
+
+static inline u32 octileDistance(i32 dx, i32 dy) {
+    const u32 ax = ni::Abs(dx);
+    const u32 ay = ni::Abs(dy);
+    const u32 lo = skMin(ax, ay);
+    const u32 hi = skMax(ax, ay);
+    return kPathStraightCost * (hi - lo) + kPathDiagonalCost * lo;
+}
+
+Pathfinder::Pathfinder(const GameGrid *grid, walkableFunc func)
+    : grid_(grid)
+    , walkableFunc_(func)
+    , width_(grid->size().w())
+    , height_(grid->size().h()) {
+    const u32 area = grid->area();
+    g_.resize(area);
+    f_.resize(area);
+    parent_.resize(area);
+    stamp_.resize(area, 0);
+    heapPos_.resize(area);
+    heap_.resize(area);
+}
+
+void CellCosts::setTypeCost(u32 type, u32 cost) {
+    if (cost == 0) {
+        skLogW("CellCosts::setTypeCost: cost of type %d must be > 0", type);
+        return;
+    }
+    if (type >= typeCosts_.size()) {
+        typeCosts_.resize(type + 1, kDefaultTypeCost);
+    }
+    typeCosts_[type] = cost;
+
+    minTypeCost_ = kDefaultTypeCost;
+    uniform_ = true;
+    for (u32 c : typeCosts_) {
+        minTypeCost_ = skMin(minTypeCost_, c);
+        uniform_ = uniform_ && c == kDefaultTypeCost;
+    }
+}
+
+u32 Pathfinder::heuristic(i32 x, i32 y) const {
+    const i32 dx = goalX_ - x;
+    const i32 dy = goalY_ - y;
+    if (allowDiagonal_) {
+        return octileDistance(dx, dy) * costs_.minTypeCost();
+    }
+    return kStraightCost * (ni::Abs(dx) + ni::Abs(dy)) * costs_.minTypeCost();
+}
+
+u32 Pathfinder::stepCost(i32 x0, i32 y0, i32 x1, i32 y1) const {
+    const u32 base = (x0 != x1 && y0 != y1) ? kDiagonalCost : kStraightCost;
+    return base * typeCost(grid_->cellAtUnchecked(x1, y1)->type);
+}
+
+bool Pathfinder::findPath(const PositionI &from, const PositionI &to, astl::vector<PositionI> &out, Algorithm algo) {
+    out.clear();
+    lastCost_ = 0;
+    lastExpanded_ = 0;
+    if (static_cast<u32>(from.x()) >= width_ || static_cast<u32>(from.y()) >= height_) {
+        return false;
+    }
+    if (!walkable(to.x(), to.y())) {
+        return false;
+    }
+    if (from == to) {
+        return true;
+    }
+
+    goalX_ = to.x();
+    goalY_ = to.y();
+    const u32 start = nodeIndex(from.x(), from.y());
+    beginSearch(start);
+
+    const bool jps = algo == Algorithm::JumpPoint && costs_.uniform() && allowDiagonal_;
+    const bool found = jps ? searchJumpPoint() : searchAStar();
+    if (found) {
+        const u32 goal = nodeIndex(goalX_, goalY_);
+        lastCost_ = g_[goal];
+        buildPath(goal, out);
+    }
+    return found;
+}
+
+void Pathfinder::beginSearch(u32 start) {
+    // Stamps tell apart the nodes touched by this search,
+    // so the buffers never need to be cleared.
+    if (++searchId_ == 0) {
+        astl::fill(stamp_.begin(), stamp_.end(), 0);
+        searchId_ = 1;
+    }
+    heapSize_ = 0;
+    stamp_[start] = searchId_;
+    g_[start] = 0;
+    f_[start] = heuristic(start % width_, start / width_);
+    parent_[start] = kNone;
+    heapPush(start);
+}
+
+void Pathfinder::relax(u32 node, u32 from, u32 g, i32 x, i32 y) {
+    if (stamp_[node] != searchId_) {
+        stamp_[node] = searchId_;
+        g_[node] = g;
+        f_[node] = g + heuristic(x, y);
+        parent_[node] = from;
+        heapPush(node);
+    }
+    else if (heapPos_[node] != kNone && g < g_[node]) {
+        f_[node] -= g_[node] - g;
+        g_[node] = g;
+        parent_[node] = from;
+        heapUp(heapPos_[node]);
+    }
+}
+
+bool Pathfinder::searchAStar() {
+    const u32 dirCount = allowDiagonal_ ? 8 : 4;
+    const u32 goal = nodeIndex(goalX_, goalY_);
+    while (heapSize_) {
+        const u32 cur = heapPop();
+        ++lastExpanded_;
+        if (cur == goal) {
+            return true;
+        }
+        const i32 x = cur % width_;
+        const i32 y = cur / width_;
+        skLoop(d, dirCount) {
+            const i32 dx = kDirs[d][0];
+            const i32 dy = kDirs[d][1];
+            const i32 nx = x + dx;
+            const i32 ny = y + dy;
+            if (!walkable(nx, ny)) {
+                continue;
+            }
+            // No corner cutting.
+            if (dx && dy && (!walkable(x + dx, y) || !walkable(x, y + dy))) {
+                continue;
+            }
+            relax(nodeIndex(nx, ny), cur, g_[cur] + stepCost(x, y, nx, ny), nx, ny);
+        }
+    }
+    return false;
+}
+
+// NOTE: Jump rules are the "no corner cutting" JPS variant,
+// diagonal moves require both orthogonal neighbours to be walkable.
+bool Pathfinder::jumpStraight(i32 x, i32 y, i32 dx, i32 dy, i32 *outX, i32 *outY) const {
+    for (;; x += dx, y += dy) {
+        if (!walkable(x, y)) {
+            return false;
+        }
+        if (x == goalX_ && y == goalY_) {
+            break;
+        }
+        if (dx) {
+            if ((walkable(x, y - 1) && !walkable(x - dx, y - 1))
+                || (walkable(x, y + 1) && !walkable(x - dx, y + 1))) {
+                break;
+            }
+        }
+        else {
+            if ((walkable(x - 1, y) && !walkable(x - 1, y - dy))
+                || (walkable(x + 1, y) && !walkable(x + 1, y - dy))) {
+                break;
+            }
+        }
+    }
+    *outX = x;
+    *outY = y;
+    return true;
+}
+
+bool Pathfinder::jumpDiagonal(i32 x, i32 y, i32 dx, i32 dy, i32 *outX, i32 *outY) const {
+    i32 jx, jy;
+    for (;; x += dx, y += dy) {
+        if (!walkable(x, y)) {
+            return false;
+        }
+        if (x == goalX_ && y == goalY_) {
+            break;
+        }
+        if (jumpStraight(x + dx, y, dx, 0, &jx, &jy)
+            || jumpStraight(x, y + dy, 0, dy, &jx, &jy)) {
+            break;
+        }
+        if (!walkable(x + dx, y) || !walkable(x, y + dy)) {
+            return false;
+        }
+    }
+    *outX = x;
+    *outY = y;
+    return true;
+}
+
+bool Pathfinder::searchJumpPoint() {
+    const u32 goal = nodeIndex(goalX_, goalY_);
+    i32 dirs[8][2];
+    while (heapSize_) {
+        const u32 cur = heapPop();
+        ++lastExpanded_;
+        if (cur == goal) {
+            return true;
+        }
+        const i32 x = cur % width_;
+        const i32 y = cur / width_;
+
+        // Prune the neighbours based on the direction we came from.
+        u32 dirCount = 0;
+        const u32 parent = parent_[cur];
+        if (parent == kNone) {
+            for (i32 dy = -1; dy <= 1; ++dy) {
+                for (i32 dx = -1; dx <= 1; ++dx) {
+                    if ((dx || dy) && (!dx || !dy || (walkable(x + dx, y) && walkable(x, y + dy)))) {
+                        dirs[dirCount][0] = dx;
+                        dirs[dirCount][1] = dy;
+                        ++dirCount;
+                    }
+                }
+            }
+        }
+        else {
+            const i32 dx = skSign(x - static_cast<i32>(parent % width_));
+            const i32 dy = skSign(y - static_cast<i32>(parent / width_));
+            auto addDir = [&](i32 ddx, i32 ddy) {
+                dirs[dirCount][0] = ddx;
+                dirs[dirCount][1] = ddy;
+                ++dirCount;
+            };
+            if (dx && dy) {
+                const bool nextY = walkable(x, y + dy);
+                const bool nextX = walkable(x + dx, y);
+                if (nextY) addDir(0, dy);
+                if (nextX) addDir(dx, 0);
+                if (nextX && nextY) addDir(dx, dy);
+            }
+            else if (dx) {
+                const bool next = walkable(x + dx, y);
+                const bool down = walkable(x, y + 1);
+                const bool up = walkable(x, y - 1);
+                if (next) {
+                    addDir(dx, 0);
+                    if (down) addDir(dx, 1);
+                    if (up) addDir(dx, -1);
+                }
+                if (down) addDir(0, 1);
+                if (up) addDir(0, -1);
+            }
+            else {
+                const bool next = walkable(x, y + dy);
+                const bool right = walkable(x + 1, y);
+                const bool left = walkable(x - 1, y);
+                if (next) {
+                    addDir(0, dy);
+                    if (right) addDir(1, dy);
+                    if (left) addDir(-1, dy);
+                }
+                if (right) addDir(1, 0);
+                if (left) addDir(-1, 0);
+            }
+        }
+
+        skLoop(d, dirCount) {
+            const i32 dx = dirs[d][0];
+            const i32 dy = dirs[d][1];
+            i32 jx, jy;
+            const bool jumped = (dx && dy)
+                ? jumpDiagonal(x + dx, y + dy, dx, dy, &jx, &jy)
+                : jumpStraight(x + dx, y + dy, dx, dy, &jx, &jy);
+            if (jumped) {
+                relax(nodeIndex(jx, jy), cur, g_[cur] + octileDistance(jx - x, jy - y), jx, jy);
+            }
+        }
+    }
+    return false;
+}
+
+void Pathfinder::buildPath(u32 goal, astl::vector<PositionI> &out) const {
+    // Walk back from the goal, expanding jump point
+    // segments into single cell steps.
+    for (u32 node = goal; parent_[node] != kNone; node = parent_[node]) {
+        const u32 parent = parent_[node];
+        i32 x = node % width_;
+        i32 y = node / width_;
+        const i32 px = parent % width_;
+        const i32 py = parent / width_;
+        const i32 dx = skSign(px - x);
+        const i32 dy = skSign(py - y);
+        while (x != px || y != py) {
+            out.push_back({ x, y });
+            x += dx;
+            y += dy;
+        }
+    }
+    astl::reverse(out.begin(), out.end());
+}
+
+bool Pathfinder::heapLess(u32 a, u32 b) const {
+    // Break ties towards the nodes closest to the goal.
+    return f_[a] < f_[b] || (f_[a] == f_[b] && g_[a] > g_[b]);
+}
+
+void Pathfinder::heapPush(u32 node) {
+    heap_[heapSize_] = node;
+    heapPos_[node] = heapSize_;
+    heapUp(heapSize_++);
+}
+
+u32 Pathfinder::heapPop() {
+    const u32 top = heap_[0];
+    heapPos_[top] = kNone;
+    if (--heapSize_) {
+        heap_[0] = heap_[heapSize_];
+        heapPos_[heap_[0]] = 0;
+        heapDown(0);
+    }
+    return top;
+}
+
+void Pathfinder::heapUp(u32 i) {
+    const u32 node = heap_[i];
+    while (i > 0) {
+        const u32 p = (i - 1) >> 1;
+        if (!heapLess(node, heap_[p])) {
+            break;
+        }
+        heap_[i] = heap_[p];
+        heapPos_[heap_[i]] = i;
+        i = p;
+    }
+    heap_[i] = node;
+    heapPos_[node] = i;
+}
+
+void Pathfinder::heapDown(u32 i) {
+    const u32 node = heap_[i];
+    for (;;) {
+        u32 c = (i << 1) + 1;
+        if (c >= heapSize_) {
+            break;
+        }
+        if (c + 1 < heapSize_ && heapLess(heap_[c + 1], heap_[c])) {
+            ++c;
+        }
+        if (!heapLess(heap_[c], node)) {
+            break;
+        }
+        heap_[i] = heap_[c];
+        heapPos_[heap_[i]] = i;
+        i = c;
+    }
+    heap_[i] = node;
+    heapPos_[node] = i;
+}
+
+FlowField::FlowField(const GameGrid *grid, Pathfinder::walkableFunc func)
+    : FlowField(grid, func, { 0, 0 }, { static_cast<i32>(grid->size().w()) - 1, static_cast<i32>(grid->size().h()) - 1 }) {
+}
+
+FlowField::FlowField(const GameGrid *grid, Pathfinder::walkableFunc func, const PositionI &a, const PositionI &b)
+    : grid_(grid)
+    , walkableFunc_(func) {
+    min_.x() = skMax(skMin(a.x(), b.x()), 0);
+    min_.y() = skMax(skMin(a.y(), b.y()), 0);
+    max_.x() = skMin(skMax(a.x(), b.x()), static_cast<i32>(grid->size().w()) - 1);
+    max_.y() = skMin(skMax(a.y(), b.y()), static_cast<i32>(grid->size().h()) - 1);
+    width_ = skMax(max_.x() - min_.x() + 1, 0);
+    height_ = skMax(max_.y() - min_.y() + 1, 0);
+    const u32 area = width_ * height_;
+    dist_.resize(area, kUnreachable);
+    dir_.resize(area, kNoDir);
+    open_.reserve(area);
+}
+
+void FlowField::setTypeCost(u32 type, u32 cost) {
+    costs_.setTypeCost(type, cost);
+    dirty_ = true;
+}
+
+void FlowField::setAllowDiagonal(bool allow) {
+    if (allow != allowDiagonal_) {
+        allowDiagonal_ = allow;
+        dirty_ = true;
+    }
+}
+
+void FlowField::setDependsOnOccupancy(bool depends) {
+    if (depends != dependsOnOccupancy_) {
+        dependsOnOccupancy_ = depends;
+        dirty_ = true;
+    }
+}
+
+void FlowField::setGoals(const PositionI *goals, u32 count) {
+    if (count == goals_.size() && astl::equal(goals_.begin(), goals_.end(), goals)) {
+        return;
+    }
+    goals_.assign(goals, goals + count);
+    dirty_ = true;
+}
+
+bool FlowField::valid() const {
+    return !dirty_ && !grid_->changedSince(builtRevision_, min_, max_, dependsOnOccupancy_);
+}
+
+bool FlowField::update() {
+    if (valid()) {
+        return false;
+    }
+    build();
+    return true;
+}
+
+u32 FlowField::distance(const PositionI &p) const {
+    return contains(p.x(), p.y()) ? dist_[localIndex(p.x(), p.y())] : kUnreachable;
+}
+
+bool FlowField::nextStep(const PositionI &p, PositionI *out) const {
+    if (!contains(p.x(), p.y())) {
+        return false;
+    }
+    const u8 dir = dir_[localIndex(p.x(), p.y())];
+    if (dir == kNoDir) {
+        return false;
+    }
+    *out = { p.x() + kDirs[dir][0], p.y() + kDirs[dir][1] };
+    return true;
+}
+
+void FlowField::build() {
+    astl::fill(dist_.begin(), dist_.end(), kUnreachable);
+    astl::fill(dir_.begin(), dir_.end(), kNoDir);
+    open_.clear();
+    auto openLess = [](u64 a, u64 b) { return a > b; };
+
+    for (const PositionI &g : goals_) {
+        if (contains(g.x(), g.y())) {
+            const u32 idx = localIndex(g.x(), g.y());
+            dist_[idx] = 0;
+            open_.push_back(idx);
+        }
+    }
+    astl::make_heap(open_.begin(), open_.end(), openLess);
+
+    // Multi-source Dijkstra from the goals.
+    // Every neighbour gets a distance, even non walkable ones
+    // (eg. cells occupied by the agents themselves), but only
+    // goals and walkable cells spread it further.
+    const u32 dirCount = allowDiagonal_ ? 8 : 4;
+    while (!open_.empty()) {
+        astl::pop_heap(open_.begin(), open_.end(), openLess);
+        const u64 top = open_.back();
+        open_.pop_back();
+        const u32 d = static_cast<u32>(top >> 32);
+        const u32 idx = static_cast<u32>(top);
+        if (d != dist_[idx]) {
+            continue;
+        }
+        const i32 x = min_.x() + idx % width_;
+        const i32 y = min_.y() + idx / width_;
+        const u32 enterCost = costs_.typeCost(grid_->cellAtUnchecked(x, y)->type);
+        skLoop(k, dirCount) {
+            const i32 nx = x - kDirs[k][0];
+            const i32 ny = y - kDirs[k][1];
+            if (!contains(nx, ny)) {
+                continue;
+            }
+            const bool diagonal = k >= 4;
+            if (diagonal && (!walkable(x, ny) || !walkable(nx, y))) {
+                continue;
+            }
+            const u32 nd = d + (diagonal ? kPathDiagonalCost : kPathStraightCost) * enterCost;
+            const u32 nidx = localIndex(nx, ny);
+            if (nd < dist_[nidx]) {
+                dist_[nidx] = nd;
+                dir_[nidx] = static_cast<u8>(k);
+                if (walkable(nx, ny)) {
+                    open_.push_back((static_cast<u64>(nd) << 32) | nidx);
+                    astl::push_heap(open_.begin(), open_.end(), openLess);
+                }
+            }
+        }
+    }
+
+    builtRevision_ = grid_->revision();
+    dirty_ = false;
+}
+
+HierarchicalPathfinder::HierarchicalPathfinder(const GameGrid *grid, Pathfinder::walkableFunc func, u32 clusterSize)
+    : grid_(grid)
+    , walkableFunc_(func)
+    , width_(grid->size().w())
+    , height_(grid->size().h())
+    , clusterSize_(skMax(clusterSize, 2u)) {
+    clustersW_ = (width_ + clusterSize_ - 1) / clusterSize_;
+    clustersH_ = (height_ + clusterSize_ - 1) / clusterSize_;
+    clusters_.resize(clustersW_ * clustersH_);
+    skLoop(cy, clustersH_) {
+        skLoop(cx, clustersW_) {
+            Cluster &c = clusters_[cy * clustersW_ + cx];
+            c.x0 = cx * clusterSize_;
+            c.y0 = cy * clusterSize_;
+            c.w = skMin(clusterSize_, width_ - c.x0);
+            c.h = skMin(clusterSize_, height_ - c.y0);
+        }
+    }
+    bordersH_.resize(clusters_.size());
+    bordersV_.resize(clusters_.size());
+    localDist_.resize(clusterSize_ * clusterSize_);
+    localParent_.resize(clusterSize_ * clusterSize_);
+}
+
+void HierarchicalPathfinder::setTypeCost(u32 type, u32 cost) {
+    costs_.setTypeCost(type, cost);
+    built_ = false;
+}
+
+void HierarchicalPathfinder::setDependsOnOccupancy(bool depends) {
+    if (dependsOnOccupancy_ != depends) {
+        dependsOnOccupancy_ = depends;
+        built_ = false;
+    }
+}
+
+void HierarchicalPathfinder::build() {
+    nodes_.clear();
+    freeNodes_.clear();
+    nodeByCell_.clear();
+    nodeCount_ = 0;
+    for (Cluster &c : clusters_) {
+        c.nodes.clear();
+        c.paths.clear();
+    }
+    skLoop(i, clusters_.size()) {
+        bordersH_[i].transitions.clear();
+        bordersV_[i].transitions.clear();
+    }
+    skLoop(cy, clustersH_) {
+        skLoop(cx, clustersW_) {
+            if (cx + 1 < static_cast<i32>(clustersW_)) {
+                rebuildBorder(cy * clustersW_ + cx, true);
+            }
+            if (cy + 1 < static_cast<i32>(clustersH_)) {
+                rebuildBorder(cy * clustersW_ + cx, false);
+            }
+        }
+    }
+    skLoop(i, clusters_.size()) {
+        rebuildIntraEdges(i);
+    }
+    built_ = true;
+    builtRevision_ = grid_->revision();
+}
+
+u32 HierarchicalPathfinder::update() {
+    if (!built_) {
+        build();
+        return clusterCount();
+    }
+    if (grid_->revision() == builtRevision_) {
+        return 0;
+    }
+
+    // Borders of the changed clusters decide the transitions of
+    // their neighbours, whose intra edges get rebuilt too.
+    astl::vector<u8> affected(clusters_.size(), 0);
+    skLoop(cy, clustersH_) {
+        skLoop(cx, clustersW_) {
+            const u32 ci = cy * clustersW_ + cx;
+            const Cluster &c = clusters_[ci];
+            const PositionI a(c.x0, c.y0);
+            const PositionI b(c.x0 + c.w - 1, c.y0 + c.h - 1);
+            if (!grid_->changedSince(builtRevision_, a, b, dependsOnOccupancy_)) {
+                continue;
+            }
+            affected[ci] = 1;
+            if (cx + 1 < static_cast<i32>(clustersW_)) {
+                rebuildBorder(ci, true);
+                affected[ci + 1] = 1;
+            }
+            if (cx > 0) {
+                rebuildBorder(ci - 1, true);
+                affected[ci - 1] = 1;
+            }
+            if (cy + 1 < static_cast<i32>(clustersH_)) {
+                rebuildBorder(ci, false);
+                affected[ci + clustersW_] = 1;
+            }
+            if (cy > 0) {
+                rebuildBorder(ci - clustersW_, false);
+                affected[ci - clustersW_] = 1;
+            }
+        }
+    }
+    u32 repaired = 0;
+    skLoop(i, clusters_.size()) {
+        if (affected[i]) {
+            rebuildIntraEdges(i);
+            ++repaired;
+        }
+    }
+    builtRevision_ = grid_->revision();
+    return repaired;
+}
+
+u32 HierarchicalPathfinder::acquireNode(u32 cell) {
+    auto it = nodeByCell_.find(cell);
+    if (it != nodeByCell_.end()) {
+        ++nodes_[it->second].refs;
+        return it->second;
+    }
+    u32 id;
+    if (!freeNodes_.empty()) {
+        id = freeNodes_.back();
+        freeNodes_.pop_back();
+    }
+    else {
+        id = nodes_.size();
+        nodes_.emplace_back();
+    }
+    Node &node = nodes_[id];
+    node.cell = cell;
+    node.cluster = clusterOf(cell % width_, cell / width_);
+    node.refs = 1;
+    node.edges.clear();
+    clusters_[node.cluster].nodes.push_back(id);
+    nodeByCell_[cell] = id;
+    ++nodeCount_;
+    return id;
+}
+
+void HierarchicalPathfinder::releaseNode(u32 id) {
+    Node &node = nodes_[id];
+    if (--node.refs > 0) {
+        return;
+    }
+    skFindEraseUnordered(clusters_[node.cluster].nodes, id);
+    nodeByCell_.erase(node.cell);
+    node.edges.clear();
+    freeNodes_.push_back(id);
+    --nodeCount_;
+}
+
+void HierarchicalPathfinder::removeEdge(u32 from, u32 to) {
+    astl::vector<Edge> &edges = nodes_[from].edges;
+    skLoop(i, edges.size()) {
+        if (edges[i].inter && edges[i].to == to) {
+            edges[i] = edges.back();
+            edges.pop_back();
+            return;
+        }
+    }
+}
+
+void HierarchicalPathfinder::rebuildBorder(u32 ci, bool horizontal) {
+    Border &border = horizontal ? bordersH_[ci] : bordersV_[ci];
+    for (u32 k = 0; k < border.transitions.size(); k += 2) {
+        removeEdge(border.transitions[k], border.transitions[k + 1]);
+        removeEdge(border.transitions[k + 1], border.transitions[k]);
+    }
+    for (u32 id : border.transitions) {
+        releaseNode(id);
+    }
+    border.transitions.clear();
+
+    // Cells of this cluster along the border, and the step across it.
+    const Cluster &c = clusters_[ci];
+    const u32 x0 = horizontal ? c.x0 + c.w - 1 : c.x0;
+    const u32 y0 = horizontal ? c.y0 : c.y0 + c.h - 1;
+    const u32 length = horizontal ? c.h : c.w;
+    const i32 ax = horizontal ? 1 : 0;
+    const i32 ay = horizontal ? 0 : 1;
+    const i32 lx = horizontal ? 0 : 1;
+    const i32 ly = horizontal ? 1 : 0;
+    auto link = [&](u32 i) {
+        const u32 x = x0 + i * lx;
+        const u32 y = y0 + i * ly;
+        const u32 cellA = y * width_ + x;
+        const u32 cellB = (y + ay) * width_ + (x + ax);
+        const u32 a = acquireNode(cellA);
+        const u32 b = acquireNode(cellB);
+        border.transitions.push_back(a);
+        border.transitions.push_back(b);
+        nodes_[a].edges.push_back({ b, kPathStraightCost * typeCost(cellB), true });
+        nodes_[b].edges.push_back({ a, kPathStraightCost * typeCost(cellA), true });
+    };
+
+    u32 runStart = kNone;
+    for (u32 i = 0; i <= length; ++i) {
+        const i32 x = x0 + i * lx;
+        const i32 y = y0 + i * ly;
+        const bool open = i < length && walkable(x, y) && walkable(x + ax, y + ay);
+        if (open && runStart == kNone) {
+            runStart = i;
+        }
+        else if (!open && runStart != kNone) {
+            const u32 runEnd = i - 1;
+            if (runEnd - runStart + 1 >= kWideEntrance) {
+                link(runStart);
+                link(runEnd);
+            }
+            else {
+                link((runStart + runEnd) / 2);
+            }
+            runStart = kNone;
+        }
+    }
+}
+
+void HierarchicalPathfinder::rebuildIntraEdges(u32 ci) {
+    Cluster &c = clusters_[ci];
+    c.paths.clear();
+    for (u32 id : c.nodes) {
+        astl::vector<Edge> &edges = nodes_[id].edges;
+        edges.erase(astl::remove_if(edges.begin(), edges.end(), [](const Edge &e) { return !e.inter; }), edges.end());
+    }
+    for (u32 id : c.nodes) {
+        searchCluster(ci, nodes_[id].cell, false, kNone);
+        for (u32 other : c.nodes) {
+            if (other == id) {
+                continue;
+            }
+            const u32 dist = localDistance(c, nodes_[other].cell);
+            if (dist != kNone) {
+                nodes_[id].edges.push_back({ other, dist, false });
+            }
+        }
+    }
+}
+
+void HierarchicalPathfinder::searchCluster(u32 ci, u32 source, bool reverse, u32 target) {
+    const Cluster &c = clusters_[ci];
+    astl::fill(localDist_.begin(), localDist_.begin() + c.w * c.h, kNone);
+    localOpen_.clear();
+    const u32 start = localIndex(c, source);
+    const u32 stop = target != kNone ? localIndex(c, target) : kNone;
+    localDist_[start] = 0;
+    localParent_[start] = kNone;
+    localOpen_.push_back(start);
+    auto cmp = [](u64 a, u64 b) { return a > b; };
+
+    while (!localOpen_.empty()) {
+        astl::pop_heap(localOpen_.begin(), localOpen_.end(), cmp);
+        const u64 top = localOpen_.back();
+        localOpen_.pop_back();
+        const u32 li = static_cast<u32>(top);
+        const u32 dist = static_cast<u32>(top >> 32);
+        if (dist != localDist_[li]) {
+            continue;
+        }
+        if (li == stop) {
+            break;
+        }
+        const i32 x = c.x0 + li % c.w;
+        const i32 y = c.y0 + li / c.w;
+        skLoop(d, 8) {
+            const i32 dx = kDirs[d][0];
+            const i32 dy = kDirs[d][1];
+            const i32 nx = x + dx;
+            const i32 ny = y + dy;
+            if (static_cast<u32>(nx - c.x0) >= c.w || static_cast<u32>(ny - c.y0) >= c.h) {
+                continue;
+            }
+            if (!walkable(nx, ny)) {
+                continue;
+            }
+            // No corner cutting.
+            if (dx && dy && (!walkable(x + dx, y) || !walkable(x, y + dy))) {
+                continue;
+            }
+            // Reversed searches pay for the cell being left,
+            // which is the one entered when walking forward.
+            const u32 entered = reverse ? y * width_ + x : ny * width_ + nx;
+            const u32 base = (dx && dy) ? kPathDiagonalCost : kPathStraightCost;
+            const u32 nd = dist + base * typeCost(entered);
+            const u32 ni = (ny - c.y0) * c.w + (nx - c.x0);
+            if (nd < localDist_[ni]) {
+                localDist_[ni] = nd;
+                localParent_[ni] = li;
+                localOpen_.push_back((static_cast<u64>(nd) << 32) | ni);
+                astl::push_heap(localOpen_.begin(), localOpen_.end(), cmp);
+            }
+        }
+    }
+}
+
+bool HierarchicalPathfinder::findAbstractPath(const PositionI &from, const PositionI &to, astl::vector<PositionI> &out) {
+    out.clear();
+    lastCost_ = 0;
+    if (static_cast<u32>(from.x()) >= width_ || static_cast<u32>(from.y()) >= height_) {
+        return false;
+    }
+    if (!walkable(to.x(), to.y())) {
+        return false;
+    }
+    if (from == to) {
+        return true;
+    }
+    update();
+
+    const u32 fromCell = from.y() * width_ + from.x();
+    const u32 toCell = to.y() * width_ + to.x();
+    const u32 startCluster = clusterOf(from.x(), from.y());
+    const u32 goalCluster = clusterOf(to.x(), to.y());
+    const u32 start = nodes_.size();
+    const u32 goal = start + 1;
+    if (stamp_.size() < goal + 1) {
+        g_.resize(goal + 1);
+        parent_.resize(goal + 1);
+        stamp_.resize(goal + 1, 0);
+        goalCost_.resize(goal + 1);
+        goalStamp_.resize(goal + 1, 0);
+    }
+    if (++searchId_ == 0) {
+        astl::fill(stamp_.begin(), stamp_.end(), 0);
+        astl::fill(goalStamp_.begin(), goalStamp_.end(), 0);
+        searchId_ = 1;
+    }
+
+    // Costs from the nodes of the goal cluster to the goal,
+    // and straight from the start when they share it.
+    const Cluster &gc = clusters_[goalCluster];
+    searchCluster(goalCluster, toCell, true, kNone);
+    for (u32 id : gc.nodes) {
+        const u32 dist = localDistance(gc, nodes_[id].cell);
+        if (dist != kNone) {
+            goalStamp_[id] = searchId_;
+            goalCost_[id] = dist;
+        }
+    }
+    const u32 direct = startCluster == goalCluster ? localDistance(gc, fromCell) : kNone;
+
+    const u32 minCost = costs_.minTypeCost();
+    auto heuristic = [&](u32 node) -> u32 {
+        if (node == goal) {
+            return 0;
+        }
+        const u32 cell = node == start ? fromCell : nodes_[node].cell;
+        return octileDistance(to.x() - static_cast<i32>(cell % width_), to.y() - static_cast<i32>(cell / width_)) * minCost;
+    };
+    auto cmp = [](u64 a, u64 b) { return a > b; };
+    open_.clear();
+    auto relax = [&](u32 node, u32 prev, u32 g) {
+        if (stamp_[node] == searchId_ && g >= g_[node]) {
+            return;
+        }
+        stamp_[node] = searchId_;
+        g_[node] = g;
+        parent_[node] = prev;
+        open_.push_back((static_cast<u64>(g + heuristic(node)) << 32) | node);
+        astl::push_heap(open_.begin(), open_.end(), cmp);
+    };
+
+    stamp_[start] = searchId_;
+    g_[start] = 0;
+    const Cluster &sc = clusters_[startCluster];
+    searchCluster(startCluster, fromCell, false, kNone);
+    for (u32 id : sc.nodes) {
+        const u32 dist = localDistance(sc, nodes_[id].cell);
+        if (dist != kNone) {
+            relax(id, start, dist);
+        }
+    }
+    if (direct != kNone) {
+        relax(goal, start, direct);
+    }
+
+    bool found = false;
+    while (!open_.empty()) {
+        astl::pop_heap(open_.begin(), open_.end(), cmp);
+        const u64 top = open_.back();
+        open_.pop_back();
+        const u32 node = static_cast<u32>(top);
+        if (static_cast<u32>(top >> 32) != g_[node] + heuristic(node)) {
+            continue;
+        }
+        if (node == goal) {
+            found = true;
+            break;
+        }
+        const u32 g = g_[node];
+        for (const Edge &e : nodes_[node].edges) {
+            relax(e.to, node, g + e.cost);
+        }
+        if (goalStamp_[node] == searchId_) {
+            relax(goal, node, g + goalCost_[node]);
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    lastCost_ = g_[goal];
+    out.push_back(to);
+    for (u32 node = parent_[goal]; node != start; node = parent_[node]) {
+        const u32 cell = nodes_[node].cell;
+        const PositionI p(cell % width_, cell / width_);
+        if (p != out.back() && p != from) {
+            out.push_back(p);
+        }
+    }
+    astl::reverse(out.begin(), out.end());
+    return true;
+}
+
+bool HierarchicalPathfinder::refineSegment(const PositionI &from, const PositionI &to, astl::vector<PositionI> &out) {
+    if (static_cast<u32>(from.x()) >= width_ || static_cast<u32>(from.y()) >= height_) {
+        return false;
+    }
+    if (!walkable(to.x(), to.y())) {
+        return false;
+    }
+    if (from == to) {
+        return true;
+    }
+    update();
+
+    const u32 ci = clusterOf(from.x(), from.y());
+    if (ci != clusterOf(to.x(), to.y())) {
+        // Transitions are orthogonal neighbours.
+        if (ni::Abs(to.x() - from.x()) + ni::Abs(to.y() - from.y()) != 1) {
+            return false;
+        }
+        out.push_back(to);
+        return true;
+    }
+
+    Cluster &c = clusters_[ci];
+    const u32 fromCell = from.y() * width_ + from.x();
+    const u32 toCell = to.y() * width_ + to.x();
+    const bool cached = nodeByCell_.count(fromCell) && nodeByCell_.count(toCell);
+    const u64 key = (static_cast<u64>(fromCell) << 32) | toCell;
+    if (cached) {
+        auto it = c.paths.find(key);
+        if (it != c.paths.end()) {
+            for (u32 cell : it->second) {
+                out.push_back(PositionI(cell % width_, cell / width_));
+            }
+            return true;
+        }
+    }
+
+    searchCluster(ci, fromCell, false, toCell);
+    if (localDistance(c, toCell) == kNone) {
+        return false;
+    }
+    astl::vector<u32> cells;
+    const u32 first = localIndex(c, fromCell);
+    for (u32 li = localIndex(c, toCell); li != first; li = localParent_[li]) {
+        cells.push_back((c.y0 + li / c.w) * width_ + (c.x0 + li % c.w));
+    }
+    astl::reverse(cells.begin(), cells.end());
+    for (u32 cell : cells) {
+        out.push_back(PositionI(cell % width_, cell / width_));
+    }
+    if (cached) {
+        c.paths[key] = astl::move(cells);
+    }
+    return true;
+}
+
+bool HierarchicalPathfinder::findPath(const PositionI &from, const PositionI &to, astl::vector<PositionI> &out) {
+    astl::vector<PositionI> waypoints;
+    if (!findAbstractPath(from, to, waypoints)) {
+        out.clear();
+        return false;
+    }
+    out.clear();
+    PositionI prev = from;
+    for (const PositionI &p : waypoints) {
+        if (!refineSegment(prev, p, out)) {
+            out.clear();
+            return false;
+        }
+        prev = p;
+    }
+    return true;
+}
+
+}; }; // namespace spark::game
@@ -41,4 +41,146 @@ bool Stats::computeStats() {
     return false;
 }
 
+constexpr StatsTable::Row StatsTable::kInvalidRow;
+constexpr u32 StatsTable::kColumnCount;
+
+StatsTable::Row StatsTable::addRow(const Stats &stats, Listener *listener) {
+    Row r;
+    if (!freeRows_.empty()) {
+        r = freeRows_.back();
+        freeRows_.pop_back();
+    }
+    else {
+        r = live_.size();
+        skLoop(c, kColumnCount) {
+            base_[c].push_back(0);
+            multiplier_[c].push_back(1.0f);
+            additive_[c].push_back(0);
+        }
+        dirty_.push_back(0);
+        live_.push_back(0);
+        listeners_.push_back(nullptr);
+    }
+    live_[r] = 1;
+    listeners_[r] = listener;
+    // Same fields as Stats' copy.
+    skLoop(c, kColumnCount) {
+        const Stats::Type t = static_cast<Stats::Type>(c);
+        const bool copied = affectsDerived(t) || t == Stats::Type::MaxActionPoints || t == Stats::Type::ActionPointsRecovery;
+        base_[c][r] = copied ? stats.get(t) : 0;
+        multiplier_[c][r] = 1.0f;
+        additive_[c][r] = 0;
+    }
+    markDirty(r);
+    return r;
+}
+
+void StatsTable::removeRow(Row r) {
+    if (!isValid(r)) {
+        skLogW("StatsTable::removeRow: invalid row %d", r);
+        return;
+    }
+    if (dirty_[r]) {
+        dirty_[r] = 0;
+        --dirtyCount_;
+    }
+    live_[r] = 0;
+    listeners_[r] = nullptr;
+    freeRows_.push_back(r);
+}
+
+void StatsTable::store(Row r, Stats &stats) {
+    skLoop(c, kColumnCount) {
+        const auto &v = stats.stats[c];
+        if (!Stats::isDerived(static_cast<Stats::Type>(c))) {
+            base_[c][r] = v.baseValue;
+        }
+        multiplier_[c][r] = v.multiplier;
+        additive_[c][r] = v.additive;
+    }
+    if (stats.consumeDirty()) {
+        markDirty(r);
+    }
+}
+
+void StatsTable::set(Row r, Stats::Type t, i32 v) {
+    base_[static_cast<u8>(t)][r] = v;
+    touched(r, t);
+}
+
+void StatsTable::applyStatMultiplier(Row r, Stats::Type t, f32 m) {
+    multiplier_[static_cast<u8>(t)][r] += m;
+    touched(r, t);
+}
+
+void StatsTable::expireStatMultiplier(Row r, Stats::Type t, f32 m) {
+    multiplier_[static_cast<u8>(t)][r] -= m;
+    touched(r, t);
+}
+
+void StatsTable::applyStatAdditive(Row r, Stats::Type t, i32 a) {
+    additive_[static_cast<u8>(t)][r] += a;
+    touched(r, t);
+}
+
+void StatsTable::expireStatAdditive(Row r, Stats::Type t, i32 a) {
+    additive_[static_cast<u8>(t)][r] -= a;
+    touched(r, t);
+}
+
+void StatsTable::resetAll(Row r) {
+    skLoop(c, kColumnCount) {
+        multiplier_[c][r] = 1.0f;
+        additive_[c][r] = 0;
+    }
+    markDirty(r);
+}
+
+u32 StatsTable::computeStats() {
+    if (dirtyCount_ == 0) {
+        return 0;
+    }
+    const u32 n = dirty_.size();
+    const u8 str = static_cast<u8>(Stats::Type::Strength);
+    const u8 intel = static_cast<u8>(Stats::Type::Intelligence);
+    const i32 *strBase = base_[str].data();
+    const f32 *strMul = multiplier_[str].data();
+    const i32 *strAdd = additive_[str].data();
+    const i32 *intBase = base_[intel].data();
+    const f32 *intMul = multiplier_[intel].data();
+    const i32 *intAdd = additive_[intel].data();
+    i32 *maxHp = base_[static_cast<u8>(Stats::Type::MaxHitPoints)].data();
+    i32 *attack = base_[static_cast<u8>(Stats::Type::AttackPower)].data();
+    i32 *spell = base_[static_cast<u8>(Stats::Type::SpellPower)].data();
+    u8 *dirty = dirty_.data();
+
+    // Listeners are told after the pass, keeping it branch-free.
+    computedRows_.clear();
+    for (u32 i = 0; i < n; ++i) {
+        if (dirty[i] && listeners_[i]) {
+            computedRows_.push_back(i);
+        }
+    }
+
+    // Same formulas as Stats::computeStats, clean rows keep their values.
+    for (u32 i = 0; i < n; ++i) {
+        const i32 s = (strBase[i] * strMul[i]) + strAdd[i];
+        const i32 in = (intBase[i] * intMul[i]) + intAdd[i];
+        const bool d = dirty[i] != 0;
+        maxHp[i] = d ? s * 10 : maxHp[i];
+        attack[i] = d ? s : attack[i];
+        spell[i] = d ? in : spell[i];
+        dirty[i] = 0;
+    }
+    const u32 computed = dirtyCount_;
+    dirtyCount_ = 0;
+    for (Row r : computedRows_) {
+        // Rows removed by an earlier listener are skipped.
+        if (listeners_[r]) {
+            listeners_[r]->onStatsComputed();
+        }
+    }
+    return computed;
+}
+
 } }; // namespace spark::game
@@ -0,0 +1,115 @@
+#include <GameVisibility.hpp>
+
+namespace spark {
+using namespace common;
+using namespace common::math;
+namespace game {
+
+static inline i64 floorDiv(i64 a, i64 b) {
+    const i64 q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+static inline i64 ceilDiv(i64 a, i64 b) {
+    return -floorDiv(-a, b);
+}
+
+FieldOfView::FieldOfView(const GameGrid *grid, u32 maxRadius)
+    : grid_(grid)
+    , maxRadius_(maxRadius)
+    , windowSize_(maxRadius * 2 + 1) {
+    bits_.resize((windowSize_ * windowSize_ + 63) >> 6, 0);
+}
+
+void FieldOfView::reveal(i32 x, i32 y) {
+    if (!grid_->cellAt({ x, y })) {
+        return;
+    }
+    const i64 dx = x - origin_.x();
+    const i64 dy = y - origin_.y();
+    if (dx * dx + dy * dy > maxDistSq_) {
+        return;
+    }
+    const u32 bit = (dy + maxRadius_) * windowSize_ + (dx + maxRadius_);
+    u64 &word = bits_[bit >> 6];
+    const u64 mask = 1ull << (bit & 63);
+    if (!(word & mask)) {
+        word |= mask;
+        ++visibleCount_;
+    }
+}
+
+bool FieldOfView::isWall(i32 x, i32 y) const {
+    // Outside of the grid blocks sight too.
+    if (static_cast<u32>(x) >= grid_->size().w() || static_cast<u32>(y) >= grid_->size().h()) {
+        return true;
+    }
+    return grid_->blocksSight(x, y);
+}
+
+void FieldOfView::compute(const PositionI &origin, u32 radius) {
+    if (radius > maxRadius_) {
+        skLogW("FieldOfView::compute: radius %d clamped to %d", radius, maxRadius_);
+        radius = maxRadius_;
+    }
+    astl::fill(bits_.begin(), bits_.end(), 0);
+    origin_ = origin;
+    radius_ = radius;
+    maxDistSq_ = static_cast<i64>(radius) * radius + radius;
+    visibleCount_ = 0;
+    if (!grid_->cellAt(origin)) {
+        return;
+    }
+
+    reveal(origin.x(), origin.y());
+    skLoop(quadrant, 4) {
+        scan(quadrant, 1, { -1, 1 }, { 1, 1 });
+    }
+}
+
+// NOTE: Symmetric shadowcasting, rows are scanned away from the
+// origin within each quadrant, narrowing the visible slopes
+// whenever a wall is met.
+void FieldOfView::scan(u32 quadrant, i32 depth, Slope start, Slope end) {
+    if (depth > static_cast<i32>(radius_)) {
+        return;
+    }
+    auto transform = [&](i32 col, i32 *x, i32 *y) {
+        switch (quadrant) {
+        case 0: *x = origin_.x() + col; *y = origin_.y() - depth; break;
+        case 1: *x = origin_.x() + col; *y = origin_.y() + depth; break;
+        case 2: *x = origin_.x() + depth; *y = origin_.y() + col; break;
+        default: *x = origin_.x() - depth; *y = origin_.y() + col; break;
+        }
+    };
+
+    // Columns whose centers lie within [start, end], ties rounded inwards.
+    const i32 minCol = floorDiv(2ll * depth * start.num + start.den, 2ll * start.den);
+    const i32 maxCol = ceilDiv(2ll * depth * end.num - end.den, 2ll * end.den);
+
+    enum { kNone, kFloor, kWall } prev = kNone;
+    for (i32 col = minCol; col <= maxCol; ++col) {
+        i32 x, y;
+        transform(col, &x, &y);
+        const bool wall = isWall(x, y);
+        const bool symmetric =
+            static_cast<i64>(col) * start.den >= static_cast<i64>(depth) * start.num
+            && static_cast<i64>(col) * end.den <= static_cast<i64>(depth) * end.num;
+        if (wall || symmetric) {
+            reveal(x, y);
+        }
+        const Slope tileSlope = { 2 * col - 1, 2 * depth };
+        if (prev == kWall && !wall) {
+            start = tileSlope;
+        }
+        if (prev == kFloor && wall) {
+            scan(quadrant, depth + 1, start, tileSlope);
+        }
+        prev = wall ? kWall : kFloor;
+    }
+    if (prev == kFloor) {
+        scan(quadrant, depth + 1, start, end);
+    }
+}
+
+}; }; // namespace spark::game
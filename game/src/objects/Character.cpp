@@ -7,11 +7,42 @@ using namespace common::math;
 namespace game {
 
 Character::Character(u32 uid, const char *name, const Stats &in)
-    : GameObject(uid, name) {
+    : GameObject(uid, name)
+    , auraPool_(&AuraPool::shared()) {
     stats_ = in;
 }
 
 Character::~Character() {
+    setStatsTable(nullptr);
+    for (AuraInstance *instance : auras_) {
+        auraPool_->destroy(instance);
+    }
+    for (AuraInstance *instance : expiredAuras_) {
+        auraPool_->destroy(instance);
+    }
+}
+
+void Character::setStatsTable(StatsTable *table) {
+    if (statsTable_) {
+        statsTable_->removeRow(statsRow_);
+        statsRow_ = StatsTable::kInvalidRow;
+        stats_.markDirty();
+    }
+    statsTable_ = table;
+    if (statsTable_) {
+        statsRow_ = statsTable_->addRow(stats_, this);
+        statsTable_->store(statsRow_, stats_);
+        statsTable_->markDirty(statsRow_);
+    }
+}
+
+bool Character::setAuraPool(AuraPool *pool) {
+    if (!auras_.empty() || !expiredAuras_.empty()) {
+        skLogW("Character::setAuraPool: %s still has auras applied", name());
+        return false;
+    }
+    auraPool_ = pool;
+    return true;
 }
 
 u8 Character::type() const {
@@ -43,8 +74,8 @@ void Character::onGridLeft(GameGrid *gg) {
 }
 
 bool Character::hasAura(u32 auraUid) const {
-    skLoopIt (it, auras_) {
-        if ((*it)->uid() == auraUid) {
+    for (const AuraInstance *instance : auras_) {
+        if (instance->aura->uid() == auraUid) {
             return true;
         }
     }
@@ -55,7 +86,12 @@ void Character::applyAura(const GameObject &src, astl::shared_ptr<Aura> aura) {
     if (hasAura(aura->uid())) {
         return;
     }
-    auras_.push_back(aura);
+    AuraInstance *instance = auraPool_->create(aura, src.uid());
+    if (aura->duration() != Aura::kPermanent) {
+        instance->expiry = auraWheel_.schedule({ instance, 0 }, aura->duration());
+    }
+    auras_.push_back(instance);
+    appliedAuras_.push_back(instance);
     for (auto l : listeners_)
         l->onAuraApplied(src, *aura.get());
     dirtyBuffs();
@@ -63,40 +99,155 @@ void Character::applyAura(const GameObject &src, astl::shared_ptr<Aura> aura) {
 
 void Character::expireAura(Aura *aura) {
     const u32 auraUid = aura->uid();
-    skLoopIt (it, auras_) {
-        astl::shared_ptr<Aura> &a = *it;
-        if (a->uid() == auraUid) {
-            auras_.erase(it);
-            for (auto l : listeners_)
-                l->onAuraExpired(*a.get());
-            dirtyBuffs();
+    skLoop(i, auras_.size()) {
+        if (auras_[i]->aura->uid() == auraUid) {
+            expireAuraAt(i);
             break;
         }
     }
 }
 
+void Character::expireAuraAt(i32 i) {
+    AuraInstance *instance = auras_[i];
+    if (instance->expiry && !auraWheel_.cancel({ instance, 0 }, instance->expiry)) {
+        dropExpiring({ instance, 0 });
+    }
+    auras_.erase(auras_.begin() + i);
+    for (auto l : listeners_)
+        l->onAuraExpired(*instance->aura);
+    // Never folded into the modifiers, nothing to undo.
+    auto pending = astl::find(appliedAuras_.begin(), appliedAuras_.end(), instance);
+    if (pending != appliedAuras_.end()) {
+        appliedAuras_.erase(pending);
+        auraPool_->destroy(instance);
+    }
+    else {
+        expiredAuras_.push_back(instance);
+    }
+    dirtyBuffs();
+}
+
+void Character::dropExpiring(const TimedAura &timed) {
+    // Off the wheel but not expired yet, only the
+    // rest of the batch being processed holds it.
+    for (u32 i = expiringCursor_; i < expiringAuras_.size(); ++i) {
+        if (expiringAuras_[i] == timed) {
+            expiringAuras_.erase(expiringAuras_.begin() + i);
+            return;
+        }
+    }
+}
+
+i32 Character::auraRecordIndex(u32 recordUid) const {
+    skLoop(i, auraRecords_.size()) {
+        if (auraRecords_[i].uid == recordUid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void Character::applyAuraRecord(const GameObject &src, const AuraRecord &record) {
+    if (auraRecordIndex(record.uid) >= 0) {
+        return;
+    }
+    auraRecords_.push_back(record);
+    auraRecords_.back().sourceUid = src.uid();
+    auraRecordExpiries_.push_back(record.duration == AuraRecord::kPermanent ? 0 : auraWheel_.schedule({ nullptr, record.uid }, record.duration));
+    appliedRecords_.push_back(auraRecords_.back());
+    dirtyBuffs();
+}
+
+void Character::expireAuraRecord(u32 recordUid) {
+    const i32 i = auraRecordIndex(recordUid);
+    if (i < 0) {
+        return;
+    }
+    if (auraRecordExpiries_[i] && !auraWheel_.cancel({ nullptr, recordUid }, auraRecordExpiries_[i])) {
+        dropExpiring({ nullptr, recordUid });
+    }
+    // Never folded into the modifiers, nothing to undo.
+    bool pending = false;
+    skLoopIt (it, appliedRecords_) {
+        if (it->uid == recordUid) {
+            appliedRecords_.erase(it);
+            pending = true;
+            break;
+        }
+    }
+    if (!pending) {
+        expiredRecords_.push_back(auraRecords_[i]);
+    }
+    // Order does not matter, swap with the last one.
+    auraRecords_[i] = auraRecords_.back();
+    auraRecords_.pop_back();
+    auraRecordExpiries_[i] = auraRecordExpiries_.back();
+    auraRecordExpiries_.pop_back();
+    dirtyBuffs();
+}
+
+void Character::validateAuras() {
+    i32 incremental[static_cast<u8>(Stats::Type::Count)];
+    skLoop(i, Stats::Type::Count) {
+        incremental[i] = stats_.computed(static_cast<Stats::Type>(i));
+    }
+    stats_.resetAll();
+    for (AuraInstance *instance : auras_) {
+        instance->aura->applyTo(this);
+    }
+    AuraModifiers modifiers;
+    modifiers.accumulate(auraRecords_.data(), auraRecords_.size(), 1);
+    modifiers.applyTo(stats_);
+    skLoop(i, Stats::Type::Count) {
+        const i32 rebuilt = stats_.computed(static_cast<Stats::Type>(i));
+        if (rebuilt != incremental[i]) {
+            skLogE("Character::validateAuras: %s stat %d is %d, expected %d", name(), i, incremental[i], rebuilt);
+        }
+    }
+}
+
 void Character::processDirty() {
-    // Process all auras for attributes.
+    // Fold the aura changes into the modifiers.
     if (hasDirtyBuffs_) {
-        // Reset all multipliers and additives.
-        stats_.resetAll();
-        for (auto &aura : auras_) {
-            if (Aura::typeAttr(*aura.get())) {
-                aura->applyTo(this);
-            }
+        for (AuraInstance *instance : expiredAuras_) {
+            instance->aura->expireFrom(this);
+            auraPool_->destroy(instance);
+        }
+        for (AuraInstance *instance : appliedAuras_) {
+            instance->aura->applyTo(this);
+        }
+        expiredAuras_.clear();
+        appliedAuras_.clear();
+        if (!expiredRecords_.empty() || !appliedRecords_.empty()) {
+            AuraModifiers delta;
+            delta.accumulate(expiredRecords_.data(), expiredRecords_.size(), -1);
+            delta.accumulate(appliedRecords_.data(), appliedRecords_.size(), 1);
+            delta.applyTo(stats_);
+            expiredRecords_.clear();
+            appliedRecords_.clear();
+        }
+        if (auraValidation_) {
+            validateAuras();
         }
     }
 
-    // Stats update based on attributes changes.
-    const bool dirtyAttrs = stats_.computeStats();
-
-    // Process all other auras.
-    if (dirtyAttrs || hasDirtyBuffs_) {
-        for (auto &aura : auras_) {
-            if (!Aura::typeAttr(*aura.get())) {
-                aura->applyTo(this);
-            }
+    // Stats update based on attributes changes,
+    // modifiers on stats do not depend on them.
+    bool dirtyAttrs;
+    bool clamp = true;
+    if (statsTable_) {
+        // Computed by the table, along with every other row.
+        dirtyAttrs = stats_.dirty();
+        if (dirtyAttrs || hasDirtyBuffs_) {
+            statsTable_->store(statsRow_, stats_);
         }
+        // Derived stats are stale until then, onStatsComputed clamps.
+        clamp = !statsTable_->dirty(statsRow_);
+    }
+    else {
+        dirtyAttrs = stats_.computeStats();
+    }
+    if (clamp && (dirtyAttrs || hasDirtyBuffs_)) {
         clampHitPoints();
         clampActionPoints();
     }
@@ -104,25 +255,48 @@ void Character::processDirty() {
     hasDirtyBuffs_ = false;
 }
 
+void Character::onStatsComputed() {
+    clampHitPoints();
+    clampActionPoints();
+}
+
 void Character::clampHitPoints() {
-    const i32 maxHp = stats_.computed(Stats::Type::MaxHitPoints);
+    const i32 maxHp = computed(Stats::Type::MaxHitPoints);
     currentHitPoints_ = skClamp(currentHitPoints_, 0, maxHp);
 }
 
 void Character::clampActionPoints() {
-    const i32 maxAp = stats_.computed(Stats::Type::MaxActionPoints);
+    const i32 maxAp = computed(Stats::Type::MaxActionPoints);
     currentActionPoints_ = skClamp(currentActionPoints_, 0, maxAp);
 }
 
 void Character::logicUpdate(u8 logicCycle) {
     // Update available action points
-    currentActionPoints_ += logicCycle * stats_.computed(Stats::Type::ActionPointsRecovery);
+    currentActionPoints_ += logicCycle * computed(Stats::Type::ActionPointsRecovery);
     clampActionPoints();
 
-    AurasVec aurasCopy = auras_;
-    skLoopIt (it, aurasCopy) {
-        (*it)->logicUpdate(logicCycle);
+    // Only the auras running out are touched.
+    auraWheel_.advance(logicCycle, &expiringAuras_);
+    // Listeners may expire auras of the batch, which drops them from it.
+    for (expiringCursor_ = 0; expiringCursor_ < expiringAuras_.size();) {
+        const TimedAura timed = expiringAuras_[expiringCursor_++];
+        if (timed.instance) {
+            auto it = astl::find(auras_.begin(), auras_.end(), timed.instance);
+            if (it == auras_.end()) {
+                skUnreachable("Character::logicUpdate: Expiring aura not applied.");
+                continue;
+            }
+            // Already off the wheel.
+            timed.instance->expiry = 0;
+            expireAuraAt(static_cast<i32>(it - auras_.begin()));
+        }
+        else {
+            expireAuraRecord(timed.recordUid);
+        }
     }
+    expiringAuras_.clear();
+    expiringCursor_ = 0;
+
     ResolvingSkillsVec resolvingSkillsCopy = resolvingSkills_;
     skLoopIt (it, resolvingSkillsCopy) {
         (*it)->logicUpdate(logicCycle);
@@ -131,9 +305,10 @@ void Character::logicUpdate(u8 logicCycle) {
 
 Skill::Effect Character::computeSkillEffect(const Skill &skill) {
     Skill::Effect ret;
-    ret.attackDamage = skMax(0, stats_.computed(Stats::Type::AttackPower) * skill.attackDamageMultiplier());
-    ret.spellDamage = stats_.computed(Stats::Type::SpellPower) * skill.spellDamageMultiplier();
+    ret.attackDamage = skMax(0, computed(Stats::Type::AttackPower) * skill.attackDamageMultiplier());
+    ret.spellDamage = computed(Stats::Type::SpellPower) * skill.spellDamageMultiplier();
     ret.auras = skill.auras();
+    ret.auraRecords = skill.auraRecords();
     return ret;
 }
 
@@ -160,7 +335,7 @@ i32 Character::attackDamageFirstPass(const GameObject &, i32 dmg) {
 }
 
 void Character::doDamage(const GameObject &src, i32 dmg) {
-    const i32 maxHp = stats_.computed(Stats::Type::MaxHitPoints);
+    const i32 maxHp = computed(Stats::Type::MaxHitPoints);
     const i32 computedHp = currentHitPoints_ - static_cast<i32>(dmg);
     currentHitPoints_ = skClamp(computedHp, 0, maxHp);
     if (dmg > 0) {
@@ -272,6 +447,9 @@ void Character::applyResolvedSkillEffect(const Skill::ResolutionInfo &resolution
     skLoopIt (it, eff.auras) {
         applyAura(src, *it);
     }
+    for (const AuraRecord &record : eff.auraRecords) {
+        applyAuraRecord(src, record);
+    }
 
     // TODO: edmond
     // Need to support skills that can expire auras
@@ -1,5 +1,6 @@
 #include "TestMain.hpp"
 #include <GameAura.hpp>
+#include <GameTimingWheel.hpp>
 #include <objects/Character.hpp>
 
 namespace spark {
@@ -157,4 +158,335 @@ TEST_F(UnitTests, Game_Character_Buffs) {
     EXPECT_EQ(stats.computed(Stats::Type::Agility), baseAgi);
 }
 
+class TimedStrengthAuraImpl : public AdditiveAura<Stats::Type::Strength> {
+public:
+    TimedStrengthAuraImpl(u32 uid, i32 add, u16 duration)
+        : AdditiveAura<Stats::Type::Strength>(uid, add, duration) {
+    }
+    const char *name() const override {
+        return "TimedStrengthAura";
+    }
+};
+
+class AdditiveMaxHitPointsAuraImpl : public AdditiveAura<Stats::Type::MaxHitPoints> {
+public:
+    AdditiveMaxHitPointsAuraImpl(u32 uid, i32 add)
+        : AdditiveAura<Stats::Type::MaxHitPoints>(uid, add) {
+    }
+    const char *name() const override {
+        return "AdditiveMaxHitPointsAura";
+    }
+};
+
+TEST_F(UnitTests, Game_Character_IncrementalBuffs) {
+    const i32 baseStr = 2;
+    Character character { 0, "Edmond", { baseStr, 1, 1 } };
+    character.setAuraValidation(true);
+    const Stats &stats = character.stats();
+    character.processDirty();
+
+    // Many auras, folded in one at a time.
+    constexpr u32 kAuras = 40;
+    astl::vector<astl::shared_ptr<AdditiveStrengthAuraImpl>> auras;
+    skLoop(i, kAuras) {
+        auras.push_back(astl::make_shared<AdditiveStrengthAuraImpl>(i, 1));
+        character.applyAura(character, auras.back());
+    }
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + static_cast<i32>(kAuras));
+
+    // Stats modifiers survive attribute changes without being reapplied.
+    astl::shared_ptr<AdditiveMaxHitPointsAuraImpl> hpAura = astl::make_shared<AdditiveMaxHitPointsAuraImpl>(kAuras, 5);
+    character.applyAura(character, hpAura);
+    character.expireAura(auras.front().get());
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + static_cast<i32>(kAuras) - 1);
+    EXPECT_EQ(stats.computed(Stats::Type::MaxHitPoints), stats.computed(Stats::Type::Strength) * 10 + 5);
+    character.rwStats().set(Stats::Type::Strength, baseStr + 1);
+    character.processDirty();
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + static_cast<i32>(kAuras));
+    EXPECT_EQ(stats.computed(Stats::Type::MaxHitPoints), stats.computed(Stats::Type::Strength) * 10 + 5);
+
+    // Applied then expired before an update, never folded in.
+    astl::shared_ptr<MultiplicativeStrengthAuraImpl> mulAura = astl::make_shared<MultiplicativeStrengthAuraImpl>(kAuras + 1, 1.0f);
+    character.applyAura(character, mulAura);
+    character.expireAura(mulAura.get());
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + static_cast<i32>(kAuras));
+
+    // Expire everything.
+    character.expireAura(hpAura.get());
+    for (auto &aura : auras) {
+        character.expireAura(aura.get());
+    }
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1);
+    EXPECT_EQ(stats.computed(Stats::Type::MaxHitPoints), (baseStr + 1) * 10);
+}
+
+TEST_F(UnitTests, Game_Character_AuraExpiry) {
+    // Wheel against a plain list, with steps and delays
+    // crossing every level.
+    TimingWheel<u32> wheel;
+    astl::vector<u32> expiries;
+    astl::vector<u32> expired;
+    u32 seed = 7;
+    auto rnd = [&seed]() { seed = seed * 1103515245u + 12345u; return seed >> 8; };
+    skLoop(step, 2000) {
+        if (rnd() % 3 != 0) {
+            const u32 delay = (rnd() % 4 == 0) ? rnd() % 70000 : rnd() % 300;
+            const u32 expiry = wheel.schedule(expiries.size(), delay);
+            EXPECT_EQ(expiry, wheel.now() + skClamp(delay, 1u, TimingWheel<u32>::kMaxDelay));
+            expiries.push_back(expiry);
+        }
+        if (rnd() % 5 == 0 && !expiries.empty()) {
+            // Cancelling twice fails.
+            const u32 id = rnd() % expiries.size();
+            const bool pending = expiries[id] > wheel.now();
+            EXPECT_EQ(wheel.cancel(id, expiries[id]), pending);
+            EXPECT_FALSE(wheel.cancel(id, expiries[id]));
+            expiries[id] = 0;
+        }
+        const u32 from = wheel.now();
+        wheel.advance(rnd() % 256, &expired);
+        for (u32 id : expired) {
+            EXPECT_GT(expiries[id], from);
+            EXPECT_LE(expiries[id], wheel.now());
+            expiries[id] = 0;
+        }
+        expired.clear();
+        u32 pending = 0;
+        for (u32 e : expiries) {
+            EXPECT_TRUE(e == 0 || e > wheel.now());
+            pending += e ? 1 : 0;
+        }
+        EXPECT_EQ(wheel.size(), pending);
+    }
+
+    // Timed auras on a character.
+    const i32 baseStr = 1;
+    Character character { 0, "Edmond", { baseStr, 1, 1 } };
+    const Stats &stats = character.stats();
+    astl::shared_ptr<TimedStrengthAuraImpl> shortAura = astl::make_shared<TimedStrengthAuraImpl>(0, 1, 3);
+    astl::shared_ptr<TimedStrengthAuraImpl> longAura = astl::make_shared<TimedStrengthAuraImpl>(1, 10, 300);
+    astl::shared_ptr<TimedStrengthAuraImpl> cancelledAura = astl::make_shared<TimedStrengthAuraImpl>(2, 100, 5);
+    astl::shared_ptr<AdditiveStrengthAuraImpl> permanentAura = astl::make_shared<AdditiveStrengthAuraImpl>(3, 1000);
+    character.applyAura(character, shortAura);
+    character.applyAura(character, longAura);
+    character.applyAura(character, cancelledAura);
+    character.applyAura(character, permanentAura);
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1111);
+
+    character.expireAura(cancelledAura.get());
+    character.logicUpdate(2);
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1011);
+    character.logicUpdate(1);
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1010);
+
+    // Reapplied, expires from now on.
+    character.applyAura(character, shortAura);
+    character.logicUpdate(255);
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1010);
+    character.logicUpdate(41);
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1010);
+    character.logicUpdate(1);
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1000);
+    skLoop(i, 1000) {
+        character.logicUpdate(255);
+    }
+    character.processDirty();
+    EXPECT_EQ(stats.computed(Stats::Type::Strength), baseStr + 1000);
+}
+
+TEST_F(UnitTests, Game_Character_AuraRecords) {
+    // Records against the equivalent auras.
+    const Stats baseStats = { 3, 5, 7 };
+    Character records { 0, "Edmond", baseStats };
+    Character auras { 1, "Dantes", baseStats };
+    records.setAuraValidation(true);
+    records.processDirty();
+    auras.processDirty();
+
+    constexpr u32 kAuras = 40;
+    skLoop(i, kAuras) {
+        const bool additive = (i % 3) != 0;
+        const Stats::Type stat = (i % 2) ? Stats::Type::Strength : Stats::Type::MaxHitPoints;
+        const f32 magnitude = additive ? static_cast<f32>(i) : 0.25f;
+        const AuraRecord record = { static_cast<u32>(i), 0, magnitude, AuraRecord::kPermanent, stat,
+                                    additive ? AuraRecord::Op::Additive : AuraRecord::Op::Multiplicative };
+        records.applyAuraRecord(auras, record);
+        if (stat == Stats::Type::Strength) {
+            if (additive) {
+                auras.applyAura(auras, astl::make_shared<AdditiveStrengthAuraImpl>(i, i));
+            }
+            else {
+                auras.applyAura(auras, astl::make_shared<MultiplicativeStrengthAuraImpl>(i, magnitude));
+            }
+        }
+        else if (additive) {
+            auras.applyAura(auras, astl::make_shared<AdditiveMaxHitPointsAuraImpl>(i, i));
+        }
+        else {
+            auras.rwStats().applyStatMultiplier(stat, magnitude);
+        }
+    }
+    records.applyAuraRecord(auras, { 0, 0, 100.0f, AuraRecord::kPermanent, Stats::Type::Agility, AuraRecord::Op::Additive });
+    EXPECT_EQ(records.auraRecords().size(), kAuras);
+    EXPECT_EQ(records.auraRecords().front().sourceUid, auras.uid());
+    records.processDirty();
+    auras.processDirty();
+    skLoop(i, Stats::Type::Count) {
+        EXPECT_EQ(records.stats().computed(static_cast<Stats::Type>(i)), auras.stats().computed(static_cast<Stats::Type>(i)));
+    }
+
+    // Expired by hand, then on time.
+    const i32 str = records.stats().computed(Stats::Type::Strength);
+    records.expireAuraRecord(1);
+    records.expireAuraRecord(1);
+    records.applyAuraRecord(auras, { kAuras, 0, 4.0f, 2, Stats::Type::Strength, AuraRecord::Op::Additive });
+    records.processDirty();
+    EXPECT_EQ(records.stats().computed(Stats::Type::Strength), str - 1 + 4);
+    records.logicUpdate(2);
+    records.processDirty();
+    EXPECT_EQ(records.stats().computed(Stats::Type::Strength), str - 1);
+    EXPECT_EQ(records.auraRecords().size(), kAuras - 1);
+
+    // Fractional additives are rounded record by record,
+    // applied in one batch then expired one by one.
+    const i32 intel = records.stats().computed(Stats::Type::Intelligence);
+    skLoop(i, 4) {
+        records.applyAuraRecord(auras, { 100u + i, 0, i < 2 ? 2.5f : -1.5f, AuraRecord::kPermanent, Stats::Type::Intelligence, AuraRecord::Op::Additive });
+    }
+    records.processDirty();
+    EXPECT_EQ(records.stats().computed(Stats::Type::Intelligence), intel + 3 + 3 - 2 - 2);
+    skLoop(i, 4) {
+        records.expireAuraRecord(100u + i);
+        records.processDirty();
+    }
+    EXPECT_EQ(records.stats().computed(Stats::Type::Intelligence), intel);
+
+    // Through a skill effect.
+    Skill::Effect effect;
+    effect.auraRecords.push_back({ kAuras + 1, 0, 2.0f, AuraRecord::kPermanent, Stats::Type::Intelligence, AuraRecord::Op::Additive });
+    records.applyResolvedSkillEffect({ &auras, effect, { 0, 0 } });
+    records.processDirty();
+    EXPECT_EQ(records.stats().computed(Stats::Type::Intelligence), 7 + 2);
+}
+
+class SiblingExpiringListener : public Character::EventListener {
+public:
+    Aura *trigger = nullptr;
+    Aura *sibling = nullptr;
+    astl::shared_ptr<Aura> replacement;
+    i32 expiredCount = 0;
+
+protected:
+    void onDamaged(const GameObject &, u32) override {}
+    void onHealed(const GameObject &, u32) override {}
+    void onDied(const GameObject &) override {}
+    void onPartyEntered(const Party &) override {}
+    void onPartyLeft(const Party &) override {}
+    void onAuraApplied(const GameObject &, const Aura &) override {}
+    void onAuraExpired(const Aura &aura) override {
+        ++expiredCount;
+        if (&aura == trigger) {
+            // The sibling's instance goes back to the pool,
+            // and straight to the replacement.
+            character()->expireAura(sibling);
+            character()->applyAura(*character(), replacement);
+        }
+    }
+    void onGridMoveRejected(u32) override {}
+    void onGridMoved(PositionI, u32) override {}
+    void onGridEntered(GameGrid *) override {}
+    void onGridLeft(GameGrid *) override {}
+};
+
+TEST_F(UnitTests, Game_Character_AuraExpiryListener) {
+    Character character { 0, "Edmond", { 1, 1, 1 } };
+    astl::shared_ptr<TimedStrengthAuraImpl> trigger = astl::make_shared<TimedStrengthAuraImpl>(0, 1, 2);
+    astl::shared_ptr<TimedStrengthAuraImpl> sibling = astl::make_shared<TimedStrengthAuraImpl>(1, 10, 2);
+    SiblingExpiringListener listener;
+    listener.trigger = trigger.get();
+    listener.sibling = sibling.get();
+    listener.replacement = astl::make_shared<AdditiveStrengthAuraImpl>(2, 100);
+    character.registerEventListener(&listener);
+
+    // Both expire within the same update, never folded in.
+    character.applyAura(character, trigger);
+    character.applyAura(character, sibling);
+    character.logicUpdate(2);
+    EXPECT_EQ(listener.expiredCount, 2);
+    character.processDirty();
+    EXPECT_EQ(character.stats().computed(Stats::Type::Strength), 101);
+
+    // Same once folded in.
+    character.expireAura(listener.replacement.get());
+    character.applyAura(character, trigger);
+    character.applyAura(character, sibling);
+    character.processDirty();
+    EXPECT_EQ(character.stats().computed(Stats::Type::Strength), 12);
+    character.logicUpdate(2);
+    EXPECT_EQ(listener.expiredCount, 5);
+    character.processDirty();
+    EXPECT_EQ(character.stats().computed(Stats::Type::Strength), 101);
+    character.unregisterEventListener(&listener);
+}
+
+TEST_F(UnitTests, Game_Character_AuraInstances) {
+    // One prototype over many targets, each expiring on its own.
+    constexpr u32 kTargets = 100;
+    AuraPool pool;
+    astl::vector<astl::unique_ptr<Character>> targets;
+    skLoop(i, kTargets) {
+        targets.emplace_back(new Character { static_cast<u32>(i), "Target", { 1, 1, 1 } });
+        EXPECT_TRUE(targets.back()->setAuraPool(&pool));
+    }
+    const Character &caster = *targets.front();
+    astl::shared_ptr<TimedStrengthAuraImpl> aura = astl::make_shared<TimedStrengthAuraImpl>(0, 5, 10);
+    for (auto &target : targets) {
+        target->applyAura(caster, aura);
+        target->processDirty();
+        EXPECT_EQ(target->stats().computed(Stats::Type::Strength), 6);
+    }
+    EXPECT_EQ(pool.liveCount(), kTargets);
+    EXPECT_EQ(pool.slabCount(), 1u);
+    EXPECT_EQ(pool.prototypeCount(), 1u);
+    EXPECT_EQ(aura.use_count(), 2);
+    EXPECT_FALSE(targets.front()->setAuraPool(&AuraPool::shared()));
+
+    // Half expire early, the others on time.
+    skLoop(i, kTargets / 2) {
+        targets[i]->expireAura(aura.get());
+        targets[i]->processDirty();
+        EXPECT_EQ(targets[i]->stats().computed(Stats::Type::Strength), 1);
+    }
+    EXPECT_EQ(pool.liveCount(), kTargets / 2);
+    for (auto &target : targets) {
+        target->logicUpdate(10);
+        target->processDirty();
+        EXPECT_EQ(target->stats().computed(Stats::Type::Strength), 1);
+    }
+    EXPECT_EQ(pool.liveCount(), 0u);
+    EXPECT_EQ(pool.prototypeCount(), 0u);
+    EXPECT_EQ(aura.use_count(), 1);
+
+    // Instances are recycled, and released along with their target.
+    skLoop(i, kTargets) {
+        targets[i]->applyAura(caster, aura);
+    }
+    EXPECT_EQ(pool.liveCount(), kTargets);
+    EXPECT_EQ(pool.slabCount(), 1u);
+    targets.clear();
+    EXPECT_EQ(pool.liveCount(), 0u);
+    EXPECT_EQ(aura.use_count(), 1);
+}
+
 }; }; // namespace spark::tests
@@ -1,6 +1,10 @@
 #include "TestMain.hpp"
 #include <GameGrid.hpp>
+#include <GameGridSnapshot.hpp>
 #include <GameObject.hpp>
+#include <StaticGameGrid.hpp>
+#include <chrono>
+#include <thread>
 
 namespace spark {
 using namespace common::math;
@@ -138,6 +142,11 @@ public:
     }
 };
 
+// Move succeeded, with or without warnings
+static bool validatorOK(GameGrid &gg, u32 err) {
+    return !gg.validator()->isError(err);
+}
+
 static u32 initTypeFuncMisc(const PositionI &p) {
     // Blocked off grid
     if (p.x() == 0
@@ -268,5 +277,1265 @@ TEST_F(UnitTests, Game_GameGrid_Init) {
     }
 }
 
+TEST_F(UnitTests, Game_GameGrid_Storage) {
+    GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncMisc};
+
+    // Unchecked and row accessors see the same cells as cellAt.
+    PositionI p;
+    skLoop(y, gh) {
+        p.y() = y;
+        const GameGrid::CellSpan row = gg.row(y);
+        EXPECT_EQ(row.size, static_cast<u32>(gw));
+        skLoop(x, gw) {
+            p.x() = x;
+            EXPECT_EQ(gg.cellAtUnchecked(x, y), gg.cellAt(p));
+            EXPECT_EQ(&row[x], gg.cellAt(p));
+        }
+    }
+
+    // Rows are laid out back to back.
+    EXPECT_EQ(gg.row(0).end(), gg.row(1).begin());
+
+    // Out of range accesses.
+    EXPECT_TRUE(gg.row(gh).empty());
+    EXPECT_EQ(gg.cellAt({ -1, 0 }), nullptr);
+    EXPECT_EQ(gg.cellAt({ gw, 0 }), nullptr);
+    EXPECT_EQ(gg.cellAt({ 0, gh }), nullptr);
+    EXPECT_EQ(gg.cellAt(PositionI::undefined()), nullptr);
+
+    // Moving updates the occupant in place.
+    DummyGameObject go { 0, "Test" };
+    EXPECT_TRUE(validatorOK(gg, gg.move(&go, { 3, 3 })));
+    EXPECT_EQ(gg.cellAtUnchecked(3, 3)->data, &go);
+    EXPECT_TRUE(validatorOK(gg, gg.move(&go, { 4, 3 })));
+    EXPECT_EQ(gg.cellAtUnchecked(3, 3)->data, nullptr);
+    EXPECT_EQ(gg.row(3)[4].data, &go);
+    gg.leave(&go);
+    EXPECT_EQ(gg.row(3)[4].data, nullptr);
+}
+
+TEST_F(UnitTests, Game_GameGrid_RangeQueries) {
+    GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround};
+
+    // Scatter a few objects, some across tile boundaries.
+    const astl::vector<PositionI> positions = {
+        { 10, 10 }, { 11, 10 }, { 13, 10 }, { 10, 15 }, { 7, 7 },
+        { 8, 8 }, { 16, 10 }, { 0, 0 }, { gw-1, gh-1 }, { 10, 7 }
+    };
+    astl::vector<astl::shared_ptr<DummyGameObject>> objects;
+    for (const PositionI &p : positions) {
+        objects.push_back(astl::make_shared<DummyGameObject>(objects.size(), "Test"));
+        EXPECT_TRUE(validatorOK(gg, gg.move(objects.back().get(), p)));
+    }
+
+    GameGrid::Listener *buffer[16];
+    const u32 kCapacity = 16;
+
+    // Radius queries match skDistance range checks.
+    for (u32 radius : { 0u, 1u, 2u, 3u, 5u, 40u }) {
+        const PositionI center { 10, 10 };
+        const u32 count = gg.queryRadius(center, radius, buffer, kCapacity);
+        u32 expected = 0;
+        for (const PositionI &p : positions) {
+            if (skDistance(center, p) <= radius) {
+                ++expected;
+            }
+        }
+        EXPECT_EQ(count, expected);
+        skLoop(i, count) {
+            EXPECT_LE(skDistance(center, buffer[i]->position()), radius);
+        }
+    }
+
+    // Rectangles are inclusive and clipped to the grid.
+    EXPECT_EQ(gg.queryRect({ 10, 10 }, { 13, 10 }, buffer, kCapacity), 3u);
+    EXPECT_EQ(gg.queryRect({ 13, 10 }, { 10, 10 }, buffer, kCapacity), 3u);
+    EXPECT_EQ(gg.queryRect({ 7, 7 }, { 8, 8 }, buffer, kCapacity), 2u);
+    EXPECT_EQ(gg.queryRect({ -5, -5 }, { 0, 0 }, buffer, kCapacity), 1u);
+    EXPECT_EQ(buffer[0], objects[7].get());
+    EXPECT_EQ(gg.queryRect({ -5, -5 }, { gw+5, gh+5 }, buffer, kCapacity), positions.size());
+    EXPECT_EQ(gg.queryRect({ gw, gh }, { gw+5, gh+5 }, buffer, kCapacity), 0u);
+
+    // Results are truncated to the buffer capacity.
+    EXPECT_EQ(gg.queryRect({ 0, 0 }, { gw-1, gh-1 }, buffer, 4), 4u);
+
+    // Cone facing right from (10,10), origin excluded.
+    const f32 kQuarterPi = 0.785398f;
+    u32 count = gg.queryCone({ 10, 10 }, {{ 1, 0 }}, 6, kQuarterPi * 0.5f, buffer, kCapacity);
+    EXPECT_EQ(count, 3u);
+    skLoop(i, count) {
+        EXPECT_EQ(buffer[i]->position().y(), 10);
+        EXPECT_GT(buffer[i]->position().x(), 10);
+    }
+    // Narrow cone facing up only finds (10,7),
+    // a quarter-pi half angle would also reach the (7,7) and (8,8) diagonal.
+    count = gg.queryCone({ 10, 10 }, {{ 0, -1 }}, 4, kQuarterPi * 0.5f, buffer, kCapacity);
+    EXPECT_EQ(count, 1u);
+    EXPECT_EQ(buffer[0], objects[9].get());
+    EXPECT_EQ(gg.queryCone({ 10, 10 }, {{ 0, 0 }}, 4, kQuarterPi, buffer, kCapacity), 0u);
+
+    // The index follows moves and leaves.
+    EXPECT_TRUE(validatorOK(gg, gg.move(objects[0].get(), { 20, 20 })));
+    EXPECT_EQ(gg.queryRadius({ 10, 10 }, 0, buffer, kCapacity), 0u);
+    EXPECT_EQ(gg.queryRadius({ 20, 20 }, 0, buffer, kCapacity), 1u);
+    gg.leave(objects[0].get());
+    EXPECT_EQ(gg.queryRadius({ 20, 20 }, 0, buffer, kCapacity), 0u);
+}
+
+static u32 initTypeFuncChunkedCalls = 0;
+static u32 initTypeFuncChunked(const PositionI &p) {
+    ++initTypeFuncChunkedCalls;
+    // A single tree in the second chunk row.
+    if (p.x() == 70 && p.y() == 70) {
+        return static_cast<u32>(CellType::BlockTree);
+    }
+    return static_cast<u32>(CellType::GroundGrass);
+}
+
+TEST_F(UnitTests, Game_GameGrid_Chunked) {
+    constexpr u32 kW = 300;
+    constexpr u32 kH = 200;
+    initTypeFuncChunkedCalls = 0;
+    GameGrid gg { { kW, kH }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncChunked, GameGrid::Layout::Chunked };
+    EXPECT_EQ(gg.layout(), GameGrid::Layout::Chunked);
+    EXPECT_EQ(gg.area(), kW * kH);
+
+    // Nothing evaluated nor allocated up front.
+    EXPECT_EQ(initTypeFuncChunkedCalls, 0u);
+    EXPECT_EQ(gg.allocatedChunks(), 0u);
+
+    // Reading a uniform chunk evaluates it without allocating it.
+    EXPECT_EQ(gg.cellAt({ 10, 10 })->type, static_cast<u32>(CellType::GroundGrass));
+    EXPECT_EQ(initTypeFuncChunkedCalls, GameGrid::kChunkArea);
+    EXPECT_EQ(gg.cellAt({ 11, 10 })->type, static_cast<u32>(CellType::GroundGrass));
+    EXPECT_EQ(initTypeFuncChunkedCalls, GameGrid::kChunkArea);
+    EXPECT_EQ(gg.allocatedChunks(), 0u);
+
+    // Partial chunks on the grid borders.
+    EXPECT_NE(gg.cellAt({ kW-1, kH-1 }), nullptr);
+    EXPECT_EQ(gg.cellAt({ kW, kH-1 }), nullptr);
+    EXPECT_EQ(gg.cellAt({ kW-1, kH }), nullptr);
+
+    // Chunks with mixed types are allocated.
+    EXPECT_EQ(gg.cellAt({ 70, 70 })->type, static_cast<u32>(CellType::BlockTree));
+    EXPECT_EQ(gg.cellAt({ 71, 70 })->type, static_cast<u32>(CellType::GroundGrass));
+    EXPECT_EQ(gg.allocatedChunks(), 1u);
+
+    // Row spans are not available.
+    EXPECT_TRUE(gg.row(0).empty());
+
+    // Entering a chunk allocates it, leaving it releases it.
+    DummyGameObject go { 0, "Test" };
+    EXPECT_TRUE(validatorOK(gg, gg.move(&go, { 10, 10 })));
+    EXPECT_EQ(gg.cellAt({ 10, 10 })->data, &go);
+    EXPECT_EQ(gg.cellAt({ 11, 10 })->data, nullptr);
+    EXPECT_EQ(gg.allocatedChunks(), 2u);
+    EXPECT_TRUE(validatorOK(gg, gg.move(&go, { 11, 10 })));
+    EXPECT_EQ(gg.cellAt({ 10, 10 })->data, nullptr);
+    EXPECT_EQ(gg.allocatedChunks(), 2u);
+    EXPECT_TRUE(validatorOK(gg, gg.move(&go, { 200, 150 })));
+    EXPECT_EQ(gg.cellAt({ 11, 10 })->data, nullptr);
+    EXPECT_EQ(gg.cellAt({ 200, 150 })->data, &go);
+    EXPECT_EQ(gg.allocatedChunks(), 2u);
+    EXPECT_EQ(gg.move(&go, { 70, 70 }), static_cast<u32>(ErrorCode::ErrorBlocked));
+    gg.leave(&go);
+    EXPECT_EQ(gg.cellAt({ 200, 150 })->data, nullptr);
+    EXPECT_EQ(gg.allocatedChunks(), 1u);
+
+    // Same goes for types, the tree chunk becomes uniform once cut down.
+    EXPECT_TRUE(gg.setCellType({ 20, 20 }, static_cast<u32>(CellType::WaterPond)));
+    EXPECT_EQ(gg.allocatedChunks(), 2u);
+    EXPECT_TRUE(gg.setCellType({ 20, 20 }, static_cast<u32>(CellType::GroundGrass)));
+    EXPECT_TRUE(gg.setCellType({ 70, 70 }, static_cast<u32>(CellType::GroundGrass)));
+    EXPECT_EQ(gg.allocatedChunks(), 0u);
+
+    // Chunks rewritten wholesale to another type collapse too,
+    // the partial border chunks included.
+    for (i32 y0 : { 0, static_cast<i32>(kH / GameGrid::kChunkSize * GameGrid::kChunkSize) }) {
+        const i32 y1 = skMin(y0 + static_cast<i32>(GameGrid::kChunkSize), static_cast<i32>(kH));
+        for (i32 y = y0; y < y1; ++y) {
+            skLoop(x, GameGrid::kChunkSize) {
+                EXPECT_TRUE(gg.setCellType({ x, y }, static_cast<u32>(CellType::WaterPond)));
+            }
+        }
+        EXPECT_EQ(gg.allocatedChunks(), 0u);
+        EXPECT_EQ(gg.cellAt({ 5, y0 + 5 })->type, static_cast<u32>(CellType::WaterPond));
+        EXPECT_TRUE(gg.setCellType({ 5, y0 + 5 }, static_cast<u32>(CellType::GroundGrass)));
+        EXPECT_EQ(gg.allocatedChunks(), 1u);
+        EXPECT_EQ(gg.cellAt({ 6, y0 + 5 })->type, static_cast<u32>(CellType::WaterPond));
+        EXPECT_TRUE(gg.setCellType({ 5, y0 + 5 }, static_cast<u32>(CellType::WaterPond)));
+        EXPECT_EQ(gg.allocatedChunks(), 0u);
+    }
+    for (i32 y = 0; y < static_cast<i32>(GameGrid::kChunkSize); ++y) {
+        skLoop(x, GameGrid::kChunkSize) {
+            gg.setCellType({ x, y }, static_cast<u32>(CellType::GroundGrass));
+        }
+    }
+
+    // Queries work the same.
+    DummyGameObject go2 { 1, "Test2" };
+    EXPECT_TRUE(validatorOK(gg, gg.move(&go, { 63, 63 })));
+    EXPECT_TRUE(validatorOK(gg, gg.move(&go2, { 64, 64 })));
+    GameGrid::Listener *buffer[4];
+    EXPECT_EQ(gg.queryRadius({ 64, 63 }, 1, buffer, 4), 2u);
+}
+
+static void registerCellTraits(GameGrid &gg) {
+    astl::vector<u32> traits(static_cast<u32>(CellType::LastDanger), 0);
+    for (u32 type = static_cast<u32>(CellType::Ground); type < static_cast<u32>(CellType::LastGround); ++type) {
+        traits[type] = GameGrid::kTraitWalkable;
+    }
+    for (u32 type = static_cast<u32>(CellType::Block); type < static_cast<u32>(CellType::LastBlock); ++type) {
+        traits[type] = GameGrid::kTraitBlocksSight;
+    }
+    for (u32 type = static_cast<u32>(CellType::Danger); type < static_cast<u32>(CellType::LastDanger); ++type) {
+        traits[type] = GameGrid::kTraitWalkable | GameGrid::kTraitDangerous;
+    }
+    gg.setTypeTraits(traits.data(), traits.size());
+}
+
+TEST_F(UnitTests, Game_GameGrid_Traits) {
+    constexpr u32 kTraitWet = 1u << 8;
+    for (GameGrid::Layout layout : { GameGrid::Layout::RowMajor, GameGrid::Layout::Chunked, GameGrid::Layout::Morton }) {
+        GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncMisc, layout };
+
+        // Nothing registered.
+        EXPECT_FALSE(gg.hasTrait(5, 5, GameGrid::kTraitWalkable));
+        EXPECT_EQ(gg.traitTileMask(GameGrid::kTraitWalkable, 0, 0), 0u);
+
+        registerCellTraits(gg);
+        gg.setTypeTraits(static_cast<u32>(CellType::WaterRiver), kTraitWet);
+        EXPECT_EQ(gg.typeTraits(static_cast<u32>(CellType::GroundGrass)), static_cast<u32>(GameGrid::kTraitWalkable));
+        EXPECT_EQ(gg.typeTraits(static_cast<u32>(CellType::Invalid)), 0u);
+
+        // Planes agree with the type classification.
+        skLoop(y, gh) {
+            skLoop(x, gw) {
+                const GameGrid::Cell &c = *gg.cellAt({ x, y });
+                EXPECT_EQ(gg.hasTrait(x, y, GameGrid::kTraitWalkable), isGround(c) || isDangerous(c));
+                EXPECT_EQ(gg.hasTrait(x, y, GameGrid::kTraitBlocksSight), isBlocked(c));
+                EXPECT_EQ(gg.hasTrait(x, y, GameGrid::kTraitDangerous), isDangerous(c));
+                EXPECT_EQ(gg.hasTrait(x, y, kTraitWet), isWater(c));
+                EXPECT_EQ(gg.blocksSight(x, y), isBlocked(c));
+            }
+        }
+
+        // A whole tile per word, the top-left one holds the borders.
+        EXPECT_EQ(gg.traitTileMask(GameGrid::kTraitBlocksSight, 0, 0), 0x01010101010101FFull);
+        EXPECT_EQ(gg.traitTileMask(GameGrid::kTraitDangerous, 0, 0), 0x020202020202FE00ull);
+        EXPECT_EQ(gg.traitTileMask(GameGrid::kTraitWalkable, 1, 1), ~0ull);
+
+        // Type changes keep the planes up to date.
+        EXPECT_TRUE(gg.setCellType({ 10, 10 }, static_cast<u32>(CellType::BlockStone)));
+        EXPECT_FALSE(gg.hasTrait(10, 10, GameGrid::kTraitWalkable));
+        EXPECT_TRUE(gg.hasTrait(10, 10, GameGrid::kTraitBlocksSight));
+        EXPECT_FALSE(gg.hasLineOfSight({ 9, 10 }, { 11, 10 }));
+        EXPECT_TRUE(gg.setCellType({ 10, 10 }, static_cast<u32>(CellType::DangerLava)));
+        EXPECT_TRUE(gg.hasTrait(10, 10, GameGrid::kTraitDangerous));
+        EXPECT_TRUE(gg.hasLineOfSight({ 9, 10 }, { 11, 10 }));
+
+        // Registering again rebuilds the planes.
+        gg.setTypeTraits(static_cast<u32>(CellType::DangerLava), 0);
+        EXPECT_FALSE(gg.hasTrait(10, 10, GameGrid::kTraitDangerous));
+        EXPECT_TRUE(gg.hasTrait(1, 5, GameGrid::kTraitDangerous));
+    }
+}
+
+static void initSpanFuncMisc(const PositionI &p, u32 *types, u32 count) {
+    PositionI c = p;
+    skLoop(i, count) {
+        c.x() = p.x() + i;
+        types[i] = initTypeFuncMisc(c);
+    }
+}
+
+TEST_F(UnitTests, Game_GameGrid_BulkInit) {
+    constexpr u32 kW = 150;
+    constexpr u32 kH = 90;
+    GameGrid reference { { kW, kH }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncMisc };
+
+    // Spans match cell by cell initialization, on any amount of threads.
+    for (u32 threads : { 1u, 4u, 200u }) {
+        for (GameGrid::Layout layout : { GameGrid::Layout::RowMajor, GameGrid::Layout::Chunked, GameGrid::Layout::Morton }) {
+            GameGrid gg { { kW, kH }, astl::make_shared<MoveValidatorImpl>(), initSpanFuncMisc, threads, layout };
+            skLoop(y, kH) {
+                skLoop(x, kW) {
+                    EXPECT_EQ(gg.cellAt({ x, y })->type, reference.cellAt({ x, y })->type);
+                    EXPECT_EQ(gg.cellAt({ x, y })->data, nullptr);
+                }
+            }
+        }
+    }
+
+    // Chunk spans are only requested when first accessed.
+    u32 spans = 0;
+    GameGrid chunked { { kW, kH }, astl::make_shared<MoveValidatorImpl>(), [&](const PositionI &p, u32 *types, u32 count) {
+        ++spans;
+        EXPECT_EQ(p.x() % GameGrid::kChunkSize, 0);
+        initSpanFuncMisc(p, types, count);
+    }, 1, GameGrid::Layout::Chunked };
+    EXPECT_EQ(spans, 0u);
+    EXPECT_NE(chunked.cellAt({ kW-1, kH-1 }), nullptr);
+    EXPECT_EQ(spans, kH - GameGrid::kChunkSize);
+
+    // Uniform grids.
+    const u32 kMud = static_cast<u32>(CellType::GroundMud);
+    for (GameGrid::Layout layout : { GameGrid::Layout::RowMajor, GameGrid::Layout::Chunked, GameGrid::Layout::Morton }) {
+        GameGrid gg { { kW, kH }, astl::make_shared<MoveValidatorImpl>(), kMud, layout };
+        skLoop(y, kH) {
+            skLoop(x, kW) {
+                EXPECT_EQ(gg.cellAt({ x, y })->type, kMud);
+            }
+        }
+        EXPECT_EQ(gg.allocatedChunks(), 0u);
+        DummyGameObject go { 0, "Test" };
+        EXPECT_TRUE(validatorOK(gg, gg.move(&go, { 100, 80 })));
+        EXPECT_EQ(gg.cellAt({ 100, 80 })->data, &go);
+        gg.leave(&go);
+    }
+}
+
+class CountingGameObject : public DummyGameObject {
+public:
+    CountingGameObject(u32 uid, const char *name) : DummyGameObject(uid, name) {}
+    void onGridEntered(GameGrid *) override { ++enteredCount; }
+    void onGridLeft(GameGrid *) override { ++leftCount; }
+    void onGridMoveRejected(u32 err) override { ++rejectedCount; lastRejected = err; }
+    void onGridMoved(PositionI, u32) override { ++movedCount; }
+    i32 enteredCount = 0;
+    i32 leftCount = 0;
+    i32 rejectedCount = 0;
+    i32 movedCount = 0;
+    u32 lastRejected = 0;
+};
+
+// Accepts any cell, occupied or not.
+class AnyCellMoveValidator : public GameGrid::MoveValidator {
+public:
+    u32 validateMove(GameGrid *, GameGrid::Listener *, const PositionI &) override { return 0; }
+    bool isOK(u32 err) override { return err == 0; }
+    bool isWarning(u32) override { return false; }
+    bool isError(u32 err) override { return err != 0; }
+};
+
+TEST_F(UnitTests, Game_GameGrid_MoveBatch) {
+    GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround};
+    EXPECT_TRUE(gg.setCellType({ 22, 20 }, static_cast<u32>(CellType::BlockStone)));
+
+    astl::vector<astl::shared_ptr<CountingGameObject>> objects;
+    auto spawn = [&](const PositionI &p) {
+        objects.push_back(astl::make_shared<CountingGameObject>(objects.size(), "Test"));
+        EXPECT_TRUE(validatorOK(gg, gg.move(objects.back().get(), p)));
+        return objects.back().get();
+    };
+    const u32 kBlocked = static_cast<u32>(ErrorCode::ErrorBlocked);
+
+    // Chains move as a whole, whatever the request order.
+    CountingGameObject *a = spawn({ 5, 5 });
+    CountingGameObject *b = spawn({ 6, 5 });
+    {
+        GameGrid::MoveRequest reqs[] = { { a, { 6, 5 }, 0 }, { b, { 7, 5 }, 0 } };
+        EXPECT_EQ(gg.moveBatch(reqs, 2), 2u);
+        EXPECT_EQ(a->position(), PositionI(6, 5));
+        EXPECT_EQ(b->position(), PositionI(7, 5));
+        EXPECT_EQ(gg.cellAt({ 5, 5 })->data, nullptr);
+        EXPECT_EQ(gg.cellAt({ 6, 5 })->data, a);
+        EXPECT_EQ(gg.cellAt({ 7, 5 })->data, b);
+        EXPECT_TRUE(gg.validator()->isOK(reqs[0].result));
+    }
+
+    // Swaps, only when allowed.
+    {
+        GameGrid::MoveRequest reqs[] = { { a, { 7, 5 }, 0 }, { b, { 6, 5 }, 0 } };
+        EXPECT_EQ(gg.moveBatch(reqs, 2, false), 0u);
+        EXPECT_EQ(reqs[0].result, GameGrid::kMoveConflict);
+        EXPECT_EQ(reqs[1].result, GameGrid::kMoveConflict);
+        EXPECT_EQ(a->position(), PositionI(6, 5));
+        EXPECT_EQ(b->rejectedCount, 1);
+        EXPECT_EQ(b->lastRejected, GameGrid::kMoveConflict);
+        EXPECT_EQ(gg.moveBatch(reqs, 2), 2u);
+        EXPECT_EQ(a->position(), PositionI(7, 5));
+        EXPECT_EQ(b->position(), PositionI(6, 5));
+        EXPECT_EQ(gg.cellAt({ 7, 5 })->data, a);
+        EXPECT_EQ(gg.cellAt({ 6, 5 })->data, b);
+    }
+
+    // Collisions go to the mover coming first in row-major order.
+    CountingGameObject *c = spawn({ 10, 10 });
+    CountingGameObject *d = spawn({ 12, 10 });
+    for (bool reversed : { false, true }) {
+        GameGrid::MoveRequest reqs[] = { { c, { 11, 10 }, 0 }, { d, { 11, 10 }, 0 } };
+        if (reversed) {
+            astl::swap(reqs[0], reqs[1]);
+        }
+        EXPECT_EQ(gg.moveBatch(reqs, 2), 1u);
+        EXPECT_EQ(c->position(), PositionI(11, 10));
+        EXPECT_EQ(d->position(), PositionI(12, 10));
+        EXPECT_EQ(reqs[reversed ? 0 : 1].result, GameGrid::kMoveConflict);
+        EXPECT_TRUE(validatorOK(gg, gg.move(c, { 10, 10 })));
+    }
+
+    // Staying put beats moving in.
+    {
+        GameGrid::MoveRequest reqs[] = { { c, { 12, 10 }, 0 }, { d, { 12, 10 }, 0 } };
+        EXPECT_EQ(gg.moveBatch(reqs, 2), 1u);
+        EXPECT_EQ(c->position(), PositionI(10, 10));
+        EXPECT_EQ(reqs[0].result, GameGrid::kMoveConflict);
+    }
+
+    // Blocked chains get rejected as a whole.
+    CountingGameObject *e = spawn({ 20, 20 });
+    CountingGameObject *f = spawn({ 21, 20 });
+    CountingGameObject *g = spawn({ 19, 20 });
+    {
+        GameGrid::MoveRequest reqs[] = { { g, { 20, 20 }, 0 }, { e, { 21, 20 }, 0 }, { f, { 22, 20 }, 0 } };
+        EXPECT_EQ(gg.moveBatch(reqs, 3), 0u);
+        EXPECT_EQ(reqs[0].result, GameGrid::kMoveConflict);
+        EXPECT_EQ(reqs[1].result, GameGrid::kMoveConflict);
+        EXPECT_EQ(reqs[2].result, kBlocked);
+        EXPECT_EQ(e->position(), PositionI(20, 20));
+        EXPECT_EQ(gg.cellAt({ 19, 20 })->data, g);
+        EXPECT_EQ(gg.cellAt({ 20, 20 })->data, e);
+        EXPECT_EQ(gg.cellAt({ 21, 20 })->data, f);
+    }
+
+    // Listeners can enter the grid in a batch.
+    CountingGameObject h { 100, "Newcomer" };
+    CountingGameObject i { 101, "Newcomer2" };
+    {
+        GameGrid::MoveRequest reqs[] = { { &h, { 25, 25 }, 0 }, { &i, { 25, 25 }, 0 } };
+        EXPECT_EQ(gg.moveBatch(reqs, 2), 1u);
+        EXPECT_EQ(h.currentGrid(), &gg);
+        EXPECT_EQ(h.enteredCount, 1);
+        EXPECT_EQ(h.movedCount, 1);
+        EXPECT_EQ(i.currentGrid(), nullptr);
+        EXPECT_EQ(i.enteredCount, 0);
+        EXPECT_EQ(i.rejectedCount, 1);
+        EXPECT_EQ(gg.listeners().size(), objects.size() + 1);
+    }
+    gg.leave(&h);
+
+    // Range queries see the committed state.
+    GameGrid::Listener *buffer[8];
+    EXPECT_EQ(gg.queryRect({ 5, 5 }, { 7, 5 }, buffer, 8), 2u);
+    EXPECT_EQ(gg.queryRadius({ 25, 25 }, 0, buffer, 8), 0u);
+
+    // Conflicts are told apart from the validator's results, even
+    // when it does not check occupancy.
+    GameGrid any { { gw, gh }, astl::make_shared<AnyCellMoveValidator>(), initTypeFuncGround };
+    CountingGameObject j { 102, "j" };
+    CountingGameObject k { 103, "k" };
+    CountingGameObject l { 104, "l" };
+    EXPECT_EQ(any.move(&l, { 3, 3 }), 0u);
+    {
+        GameGrid::MoveRequest reqs[] = { { &j, { 2, 2 }, 0 }, { &k, { 2, 2 }, 0 } };
+        EXPECT_EQ(any.moveBatch(reqs, 2), 1u);
+        EXPECT_EQ(reqs[0].result, 0u);
+        EXPECT_EQ(reqs[1].result, GameGrid::kMoveConflict);
+        EXPECT_EQ(k.lastRejected, GameGrid::kMoveConflict);
+        // Into a cell whose occupant stays put.
+        GameGrid::MoveRequest into[] = { { &j, { 3, 3 }, 0 } };
+        EXPECT_EQ(any.moveBatch(into, 1), 0u);
+        EXPECT_EQ(into[0].result, GameGrid::kMoveConflict);
+        EXPECT_EQ(j.lastRejected, GameGrid::kMoveConflict);
+        EXPECT_EQ(any.cellAt({ 3, 3 })->data, &l);
+    }
+    any.leave(&j);
+    any.leave(&l);
+}
+
+TEST_F(UnitTests, Game_GameGrid_Footprints) {
+    for (GameGrid::Layout layout : { GameGrid::Layout::RowMajor, GameGrid::Layout::Chunked, GameGrid::Layout::Morton }) {
+        GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround, layout };
+        EXPECT_TRUE(gg.setCellType({ 20, 20 }, static_cast<u32>(CellType::BlockStone)));
+        const u32 kOccupied = static_cast<u32>(ErrorCode::ErrorOccupied);
+        const u32 kBlocked = static_cast<u32>(ErrorCode::ErrorBlocked);
+        const u32 kOutOfRange = static_cast<u32>(ErrorCode::ErrorOutOfRange);
+        auto countOccupied = [&](const GameGrid::Listener *ggl) {
+            u32 count = 0;
+            skLoop(y, gh) {
+                skLoop(x, gw) {
+                    count += gg.cellAt({ x, y })->data == ggl ? 1 : 0;
+                }
+            }
+            return count;
+        };
+
+        CountingGameObject boss { 0, "Boss" };
+        boss.setSize({ 3, 2 });
+        EXPECT_TRUE(validatorOK(gg, gg.move(&boss, { 4, 4 })));
+        EXPECT_EQ(boss.footprint(), SizeU(3, 2));
+        EXPECT_EQ(countOccupied(&boss), 6u);
+        EXPECT_EQ(gg.cellAt({ 6, 5 })->data, &boss);
+        EXPECT_EQ(gg.cellAt({ 7, 5 })->data, nullptr);
+
+        // Other listeners cannot overlap.
+        CountingGameObject minion { 1, "Minion" };
+        EXPECT_EQ(gg.move(&minion, { 5, 5 }), kOccupied);
+        EXPECT_TRUE(validatorOK(gg, gg.move(&minion, { 8, 4 })));
+        EXPECT_EQ(gg.move(&boss, { 6, 4 }), kOccupied);
+        EXPECT_EQ(gg.move(&boss, { 18, 19 }), kBlocked);
+        EXPECT_EQ(gg.move(&boss, { gw-2, 0 }), kOutOfRange);
+        EXPECT_EQ(boss.position(), PositionI(4, 4));
+        EXPECT_EQ(countOccupied(&boss), 6u);
+
+        // Moving onto its own cells only touches the ones that changed.
+        u32 revision = gg.revision();
+        EXPECT_TRUE(validatorOK(gg, gg.move(&boss, { 5, 5 })));
+        EXPECT_EQ(gg.revision() - revision, 8u);
+        EXPECT_EQ(countOccupied(&boss), 6u);
+        EXPECT_EQ(gg.cellAt({ 4, 4 })->data, nullptr);
+        EXPECT_EQ(gg.cellAt({ 7, 6 })->data, &boss);
+
+        // Resizing takes effect on the next move.
+        boss.setSize({ 2, 2 });
+        EXPECT_EQ(countOccupied(&boss), 6u);
+        revision = gg.revision();
+        EXPECT_TRUE(validatorOK(gg, gg.move(&boss, { 5, 5 })));
+        EXPECT_EQ(gg.revision() - revision, 2u);
+        EXPECT_EQ(countOccupied(&boss), 4u);
+
+        // Gathered once by queries.
+        GameGrid::Listener *buffer[8];
+        EXPECT_EQ(gg.queryRect({ 0, 0 }, { gw-1, gh-1 }, buffer, 8), 2u);
+        EXPECT_EQ(gg.queryRadius({ 6, 7 }, 1, buffer, 8), 1u);
+        EXPECT_EQ(buffer[0], &boss);
+
+        // Batches move larger listeners once the others settled.
+        boss.setSize({ 2, 3 });
+        GameGrid::MoveRequest reqs[] = { { &boss, { 8, 3 }, 0 }, { &minion, { 9, 8 }, 0 } };
+        EXPECT_EQ(gg.moveBatch(reqs, 2), 2u);
+        EXPECT_EQ(boss.position(), PositionI(8, 3));
+        EXPECT_EQ(boss.footprint(), SizeU(2, 3));
+        EXPECT_EQ(countOccupied(&boss), 6u);
+        EXPECT_EQ(gg.cellAt({ 9, 8 })->data, &minion);
+        EXPECT_EQ(boss.movedCount, 2 + 1 + 1);
+
+        // Single cell movers see them standing still.
+        GameGrid::MoveRequest reqs2[] = { { &minion, { 9, 5 }, 0 }, { &boss, { 12, 3 }, 0 } };
+        EXPECT_EQ(gg.moveBatch(reqs2, 2), 1u);
+        EXPECT_EQ(reqs2[0].result, kOccupied);
+        EXPECT_EQ(boss.position(), PositionI(12, 3));
+
+        EXPECT_TRUE(gg.leave(&boss));
+        EXPECT_EQ(countOccupied(&boss), 0u);
+        EXPECT_TRUE(gg.leave(&minion));
+        EXPECT_EQ(gg.queryRect({ 0, 0 }, { gw-1, gh-1 }, buffer, 8), 0u);
+        if (layout == GameGrid::Layout::Chunked) {
+            // Only kept for the blocked cell.
+            EXPECT_EQ(gg.allocatedChunks(), 1u);
+        }
+    }
+}
+
+TEST_F(UnitTests, Game_GameGrid_Journal) {
+    GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround };
+    GameGrid::Journal journal;
+    DummyGameObject a { 0, "A" };
+    DummyGameObject b { 1, "B" };
+
+    // Nothing gets recorded until enabled.
+    EXPECT_TRUE(validatorOK(gg, gg.move(&a, { 1, 1 })));
+    EXPECT_FALSE(gg.isTileDirty(0, 0));
+    gg.setJournalEnabled(true);
+    gg.drainJournal(journal);
+    EXPECT_TRUE(journal.cells.empty());
+    EXPECT_TRUE(journal.moved.empty());
+
+    EXPECT_TRUE(validatorOK(gg, gg.move(&a, { 2, 1 })));
+    EXPECT_TRUE(validatorOK(gg, gg.move(&a, { 3, 1 })));
+    EXPECT_TRUE(validatorOK(gg, gg.move(&b, { 20, 9 })));
+    EXPECT_TRUE(gg.setCellType({ 2, 1 }, static_cast<u32>(CellType::GroundMud)));
+    EXPECT_TRUE(gg.setCellType({ 30, 30 }, static_cast<u32>(CellType::Water)));
+    EXPECT_TRUE(gg.isTileDirty(0, 0));
+    EXPECT_TRUE(gg.isTileDirty(2, 1));
+    EXPECT_TRUE(gg.isTileDirty(3, 3));
+    EXPECT_FALSE(gg.isTileDirty(1, 0));
+
+    gg.drainJournal(journal);
+    EXPECT_EQ(journal.tilesW, static_cast<u32>(gw / GameGrid::kTileSize));
+    ASSERT_EQ(journal.cells.size(), 5u);
+    auto expectChange = [&](u32 i, u32 x, u32 y, u8 flags) {
+        EXPECT_EQ(journal.cells[i].x, x);
+        EXPECT_EQ(journal.cells[i].y, y);
+        EXPECT_EQ(journal.cells[i].flags, flags);
+    };
+    expectChange(0, 1, 1, GameGrid::kCellOccupantChanged);
+    expectChange(1, 2, 1, GameGrid::kCellOccupantChanged | GameGrid::kCellTypeChanged);
+    expectChange(2, 3, 1, GameGrid::kCellOccupantChanged);
+    expectChange(3, 20, 9, GameGrid::kCellOccupantChanged);
+    expectChange(4, 30, 30, GameGrid::kCellTypeChanged);
+    ASSERT_EQ(journal.moved.size(), 2u);
+    EXPECT_EQ(journal.moved[0], &a);
+    EXPECT_EQ(journal.moved[1], &b);
+    u32 dirtyTiles = 0;
+    for (u64 bits : journal.dirtyTiles) {
+        for (; bits; bits &= bits - 1) {
+            ++dirtyTiles;
+        }
+    }
+    EXPECT_EQ(dirtyTiles, 3u);
+
+    // Drained, nothing left until the next change.
+    EXPECT_FALSE(gg.isTileDirty(0, 0));
+    gg.drainJournal(journal);
+    EXPECT_TRUE(journal.cells.empty());
+    EXPECT_TRUE(journal.moved.empty());
+
+    // Unchanged cells and listeners leaving are not reported as moves.
+    EXPECT_TRUE(gg.setCellType({ 30, 30 }, static_cast<u32>(CellType::Water)));
+    GameGrid::MoveRequest reqs[] = { { &a, { 3, 1 }, 0 }, { &b, { 21, 9 }, 0 } };
+    EXPECT_EQ(gg.moveBatch(reqs, 2), 2u);
+    EXPECT_TRUE(gg.leave(&b));
+    gg.drainJournal(journal);
+    EXPECT_TRUE(journal.moved.empty());
+    ASSERT_EQ(journal.cells.size(), 2u);
+    expectChange(0, 20, 9, GameGrid::kCellOccupantChanged);
+    expectChange(1, 21, 9, GameGrid::kCellOccupantChanged);
+    gg.leave(&a);
+}
+
+typedef StaticGameGrid<20, 12, u8> ArenaGrid;
+
+static u8 initTypeFuncArena(const PositionI &p) {
+    return (p.x() == 10 && p.y() != 6) ? 1 : 0;
+}
+
+class ArenaMoveValidator : public ArenaGrid::MoveValidator {
+public:
+    u32 validateMove(ArenaGrid *gg, ArenaGrid::Listener *ggl, const PositionI &p) override {
+        const ArenaGrid::Cell *c = gg->cellAt(p);
+        if (!c || c->type != 0) {
+            return 1;
+        }
+        return (c->data && c->data != ggl) ? 2 : 0;
+    }
+    bool isOK(u32 err) override { return err == 0; }
+    bool isWarning(u32) override { return false; }
+    bool isError(u32 err) override { return err != 0; }
+};
+
+class ArenaObject : public ArenaGrid::Listener {
+public:
+    void setSize(SizeU) override {}
+    SizeU size() const override { return { 1, 1 }; }
+    void setPosition(PositionI p) override { position_ = p; }
+    PositionI position() const override { return position_; }
+    void onGridEntered(ArenaGrid *) override { ++enteredCount; }
+    void onGridLeft(ArenaGrid *) override { ++leftCount; }
+    void onGridMoveRejected(u32) override { ++rejectedCount; }
+    void onGridMoved(PositionI, u32) override {}
+    i32 enteredCount = 0;
+    i32 leftCount = 0;
+    i32 rejectedCount = 0;
+
+private:
+    PositionI position_ = PositionI::undefined();
+};
+
+TEST_F(UnitTests, Game_StaticGameGrid) {
+    static_assert(ArenaGrid::index(3, 2) == 43, "constexpr index");
+    static_assert(ArenaGrid::area() == 240, "constexpr area");
+    static_assert(!ArenaGrid::contains(-1, 0) && !ArenaGrid::contains(20, 0), "constexpr bounds");
+    static_assert(sizeof(ArenaGrid::Cell) <= sizeof(GameGrid::Cell), "narrow cell types");
+    static_assert(GridTiles::tileAreaMask(0, 0, 7, 7) == ~0ull && GridTiles::tileAreaMask(1, 1, 1, 1) == 1ull << 9, "constexpr tile masks");
+
+    ArenaGrid gg { astl::make_shared<ArenaMoveValidator>(), initTypeFuncArena };
+    EXPECT_EQ(gg.size(), SizeU(20, 12));
+    EXPECT_EQ(gg.cellAt({ 10, 0 })->type, 1);
+    EXPECT_EQ(gg.cellAt({ 10, 6 })->type, 0);
+    EXPECT_EQ(gg.cellAt({ 20, 0 }), nullptr);
+    EXPECT_EQ(gg.cellAt({ 0, -1 }), nullptr);
+
+    ArenaObject a, b;
+    EXPECT_EQ(gg.move(&a, { 2, 2 }), 0u);
+    EXPECT_EQ(a.currentGrid(), &gg);
+    EXPECT_EQ(a.enteredCount, 1);
+    EXPECT_EQ(gg.move(&b, { 2, 2 }), 2u);
+    EXPECT_EQ(b.currentGrid(), nullptr);
+    EXPECT_EQ(b.rejectedCount, 1);
+    EXPECT_EQ(gg.move(&b, { 10, 2 }), 1u);
+    EXPECT_EQ(gg.move(&b, { 15, 9 }), 0u);
+    EXPECT_EQ(gg.listenerCount(), 2u);
+
+    EXPECT_EQ(gg.move(&a, { 3, 2 }), 0u);
+    EXPECT_EQ(gg.cellAt({ 2, 2 })->data, nullptr);
+    EXPECT_EQ(gg.cellAt({ 3, 2 })->data, &a);
+
+    ArenaGrid::Listener *buffer[4];
+    EXPECT_EQ(gg.queryRect({ 0, 0 }, { 19, 11 }, buffer, 4), 2u);
+    EXPECT_EQ(gg.queryRect({ 0, 0 }, { 9, 11 }, buffer, 4), 1u);
+    EXPECT_EQ(buffer[0], &a);
+    EXPECT_EQ(gg.queryRadius({ 15, 7 }, 2, buffer, 4), 1u);
+    EXPECT_EQ(buffer[0], &b);
+    EXPECT_EQ(gg.queryRadius({ 15, 6 }, 2, buffer, 4), 0u);
+
+    EXPECT_TRUE(gg.setCellType({ 10, 6 }, 1));
+    EXPECT_FALSE(gg.setCellType({ 10, 12 }, 1));
+    EXPECT_EQ(gg.move(&a, { 10, 6 }), 1u);
+
+    EXPECT_TRUE(gg.leave(&a));
+    EXPECT_FALSE(gg.leave(&a));
+    EXPECT_EQ(a.leftCount, 1);
+    EXPECT_EQ(gg.listenerCount(), 1u);
+    EXPECT_EQ(gg.listeners()[0], &b);
+    EXPECT_EQ(gg.queryRect({ 0, 0 }, { 9, 11 }, buffer, 4), 0u);
+
+    // The last listener takes the slot of the one leaving.
+    ArenaObject c, d;
+    EXPECT_EQ(gg.move(&c, { 4, 4 }), 0u);
+    EXPECT_EQ(gg.move(&d, { 5, 4 }), 0u);
+    EXPECT_TRUE(gg.leave(&b));
+    EXPECT_EQ(gg.listenerCount(), 2u);
+    EXPECT_EQ(gg.listeners()[0], &d);
+    EXPECT_EQ(gg.listeners()[1], &c);
+    EXPECT_TRUE(gg.leave(&d));
+    EXPECT_EQ(gg.listeners()[0], &c);
+    EXPECT_TRUE(gg.leave(&c));
+    EXPECT_EQ(gg.listenerCount(), 0u);
+}
+
+TEST_F(UnitTests, Game_GameGrid_EnterLeaveMany) {
+    GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround};
+    EXPECT_TRUE(gg.setCellType({ 3, 0 }, static_cast<u32>(CellType::BlockStone)));
+    gg.setJournalEnabled(true);
+    constexpr u32 kCount = 8;
+    CountingGameObject gos[kCount] = {
+        { 0, "go0" }, { 1, "go1" }, { 2, "go2" }, { 3, "go3" },
+        { 4, "go4" }, { 5, "go5" }, { 6, "go6" }, { 7, "go7" },
+    };
+    astl::vector<GameGrid::MoveRequest> requests;
+    skLoop(i, kCount) {
+        requests.push_back({ &gos[i], { static_cast<i32>(i), 0 }, 0 });
+    }
+
+    // The blocked cell gets rejected, the others enter.
+    EXPECT_EQ(gg.enterMany(requests.data(), kCount), kCount - 1);
+    EXPECT_FALSE(gg.validator()->isError(requests[2].result));
+    EXPECT_TRUE(gg.validator()->isError(requests[3].result));
+    EXPECT_EQ(gg.listeners().size(), kCount - 1);
+    EXPECT_EQ(gos[0].enteredCount, 1);
+    EXPECT_EQ(gos[3].rejectedCount, 1);
+    EXPECT_EQ(gos[3].currentGrid(), nullptr);
+
+    // Leaving from the middle keeps the rest reachable.
+    GameGrid::Listener *leaving[] = { &gos[1], &gos[3], &gos[5], &gos[1] };
+    EXPECT_EQ(gg.leaveMany(leaving, 4), 2u);
+    EXPECT_EQ(gg.listeners().size(), kCount - 3);
+    EXPECT_EQ(gos[1].leftCount, 1);
+    EXPECT_EQ(gos[3].leftCount, 0);
+    EXPECT_EQ(gg.cellAt({ 5, 0 })->data, nullptr);
+    for (GameGrid::Listener *ggl : gg.listeners()) {
+        EXPECT_EQ(ggl->currentGrid(), &gg);
+    }
+    GameGrid::Journal journal;
+    gg.drainJournal(journal);
+    EXPECT_EQ(journal.moved.size(), kCount - 3);
+
+    // Slots get reused.
+    EXPECT_EQ(gg.move(&gos[1], { 1, 1 }), 0u);
+    EXPECT_TRUE(gg.leave(&gos[0]));
+    EXPECT_EQ(gg.listeners().size(), kCount - 3);
+    astl::vector<GameGrid::Listener *> rest(gg.listeners().begin(), gg.listeners().end());
+    EXPECT_EQ(gg.leaveMany(rest.data(), rest.size()), kCount - 3);
+    EXPECT_TRUE(gg.listeners().empty());
+    for (const CountingGameObject &go : gos) {
+        EXPECT_EQ(go.currentGrid(), nullptr);
+    }
+}
+
+// Records every callback as uid * 10 + kind, 0 entered, 1 left, 2 moved, 3 rejected.
+class RecordingGameObject : public DummyGameObject {
+public:
+    RecordingGameObject(u32 uid, astl::vector<u32> *log) : DummyGameObject(uid, "recording"), log_(log) {}
+    void onGridEntered(GameGrid *) override { log_->push_back(uid() * 10); }
+    void onGridLeft(GameGrid *) override { log_->push_back(uid() * 10 + 1); }
+    void onGridMoved(PositionI p, u32) override {
+        log_->push_back(uid() * 10 + 2);
+        if (followUp && p != *followUp) {
+            // Re-entrant move, from within a callback.
+            currentGrid()->move(this, *followUp);
+        }
+    }
+    void onGridMoveRejected(u32) override { log_->push_back(uid() * 10 + 3); }
+    const PositionI *followUp = nullptr;
+
+private:
+    astl::vector<u32> *log_;
+};
+
+TEST_F(UnitTests, Game_GameGrid_DeferredEvents) {
+    GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround};
+    EXPECT_TRUE(gg.setCellType({ 5, 5 }, static_cast<u32>(CellType::BlockStone)));
+    astl::vector<u32> log;
+    RecordingGameObject a { 1, &log };
+    RecordingGameObject b { 2, &log };
+
+    // Nothing is delivered until dispatched.
+    gg.setDeferredEvents(true);
+    EXPECT_EQ(gg.move(&a, { 1, 1 }), 0u);
+    EXPECT_EQ(gg.move(&b, { 2, 2 }), 0u);
+    EXPECT_EQ(gg.move(&a, { 1, 2 }), 0u);
+    EXPECT_NE(gg.move(&b, { 5, 5 }), 0u);
+    EXPECT_TRUE(log.empty());
+    EXPECT_EQ(gg.pendingEvents(), 6u);
+    EXPECT_EQ(a.position(), PositionI(1, 2));
+
+    // Grouped by listener, in order for each.
+    EXPECT_EQ(gg.dispatchEvents(), 6u);
+    const u32 grouped[] = { 10, 12, 12, 20, 22, 23 };
+    ASSERT_EQ(log.size(), 6u);
+    skLoop(i, 6) {
+        EXPECT_EQ(log[i], grouped[i]);
+    }
+    EXPECT_EQ(gg.dispatchEvents(), 0u);
+
+    // Moves from callbacks are queued for the next dispatch.
+    log.clear();
+    const PositionI next { 3, 3 };
+    a.followUp = &next;
+    EXPECT_EQ(gg.move(&a, { 2, 1 }), 0u);
+    EXPECT_EQ(gg.dispatchEvents(), 1u);
+    EXPECT_EQ(a.position(), next);
+    EXPECT_EQ(gg.pendingEvents(), 1u);
+    EXPECT_EQ(gg.dispatchEvents(), 1u);
+    EXPECT_EQ(log.size(), 2u);
+    a.followUp = nullptr;
+
+    // Batches and leaves get deferred too, disabling delivers what is left.
+    log.clear();
+    GameGrid::MoveRequest requests[] = { { &a, { 4, 3 }, 0 }, { &b, { 3, 3 }, 0 } };
+    EXPECT_EQ(gg.moveBatch(requests, 2), 2u);
+    EXPECT_TRUE(gg.leave(&b));
+    EXPECT_TRUE(log.empty());
+    gg.setDeferredEvents(false);
+    const u32 batched[] = { 12, 22, 21 };
+    ASSERT_EQ(log.size(), 3u);
+    skLoop(i, 3) {
+        EXPECT_EQ(log[i], batched[i]);
+    }
+    EXPECT_TRUE(gg.leave(&a));
+    EXPECT_EQ(log.back(), 11u);
+}
+
+// Walks one cell per cycle towards its goal, reading the grid only.
+class PlanningGameObject : public DummyGameObject {
+public:
+    PlanningGameObject(u32 uid, const PositionI &goal) : DummyGameObject(uid, "planner"), goal_(goal) {}
+    void onGridLogicUpdate(u8) override {
+        updatedOffThread |= std::this_thread::get_id() != updateThread;
+    }
+    bool onGridPlanMove(u8, PositionI *target) override {
+        const PositionI p = position();
+        const i32 dx = (goal_.x() > p.x()) - (goal_.x() < p.x());
+        const i32 dy = (goal_.y() > p.y()) - (goal_.y() < p.y());
+        if (!dx && !dy) {
+            return false;
+        }
+        const GameGrid::Cell *c = currentGrid()->cellAt({ p.x() + dx, p.y() + dy });
+        if (!c || isBlocked(*c)) {
+            return false;
+        }
+        *target = { p.x() + dx, p.y() + dy };
+        return true;
+    }
+
+    std::thread::id updateThread = std::this_thread::get_id();
+    bool updatedOffThread = false;
+
+private:
+    PositionI goal_;
+};
+
+TEST_F(UnitTests, Game_GameGrid_ParallelMovePlanning) {
+    constexpr u32 kWalkers = 96;
+    constexpr u32 kRegionSize = 8;
+    astl::vector<PositionI> results[2];
+    u32 crossing[2] = { 0, 0 };
+    const u32 threads[2] = { 1, 4 };
+    skLoop(run, 2) {
+        GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround};
+        EXPECT_TRUE(gg.setCellType({ 16, 16 }, static_cast<u32>(CellType::BlockStone)));
+        gg.setParallelMovePlanning(kRegionSize, threads[run]);
+        EXPECT_EQ(gg.planningThreads(), threads[run]);
+
+        // Walkers crossing each other's paths, through several regions.
+        astl::vector<PlanningGameObject> walkers;
+        walkers.reserve(kWalkers);
+        skLoop(i, kWalkers) {
+            const PositionI from { (i * 7) % gw, (i * 5 + i / gw) % gh };
+            const PositionI goal { gw - 1 - (i * 3) % gw, (i * 11) % gh };
+            walkers.emplace_back(i, goal);
+            gg.move(&walkers.back(), from);
+        }
+        skLoop(cycle, 40) {
+            gg.logicUpdate(1);
+            crossing[run] += gg.lastCrossingMoves();
+            EXPECT_LE(gg.lastCrossingMoves(), gg.lastPlannedMoves());
+        }
+        for (const PlanningGameObject &walker : walkers) {
+            // Only planning runs on the workers.
+            EXPECT_FALSE(walker.updatedOffThread);
+            results[run].push_back(walker.currentGrid() ? walker.position() : PositionI::undefined());
+        }
+        // Nothing left to plan once everyone settled.
+        gg.logicUpdate(1);
+        gg.setParallelMovePlanning(0, 1);
+        gg.logicUpdate(1);
+        EXPECT_EQ(gg.lastPlannedMoves(), 0u);
+        for (PlanningGameObject &walker : walkers) {
+            gg.leave(&walker);
+        }
+    }
+
+    // Same outcome whatever the thread count.
+    EXPECT_GT(crossing[0], 0u);
+    EXPECT_EQ(crossing[0], crossing[1]);
+    ASSERT_EQ(results[0].size(), results[1].size());
+    skLoop(i, results[0].size()) {
+        EXPECT_EQ(results[0][i], results[1][i]);
+    }
+}
+
+TEST_F(UnitTests, Game_GameGrid_Snapshot) {
+    GameGrid gg { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround};
+    EXPECT_TRUE(gg.setCellType({ 4, 1 }, static_cast<u32>(CellType::BlockStone)));
+    DummyGameObject a { 0, "a" };
+    DummyGameObject b { 1, "b" };
+    EXPECT_EQ(gg.move(&a, { 1, 1 }), 0u);
+    EXPECT_EQ(gg.move(&b, { 1, 2 }), 0u);
+
+    // Reads go through to the grid until written to.
+    GameGridSnapshot snapshot { &gg, [](const GameGrid::Cell &c) { return isGround(c); } };
+    EXPECT_EQ(snapshot.pageCount(), 0u);
+    EXPECT_EQ(snapshot.cellAt({ 1, 1 }), gg.cellAt({ 1, 1 }));
+    EXPECT_EQ(snapshot.position(&a), PositionI(1, 1));
+
+    // Moves only touch the snapshot.
+    EXPECT_TRUE(snapshot.move(&a, { 2, 1 }));
+    EXPECT_EQ(snapshot.pageCount(), 1u);
+    EXPECT_EQ(snapshot.position(&a), PositionI(2, 1));
+    EXPECT_EQ(snapshot.cellAt({ 2, 1 })->data, &a);
+    EXPECT_EQ(snapshot.cellAt({ 1, 1 })->data, nullptr);
+    EXPECT_EQ(a.position(), PositionI(1, 1));
+    EXPECT_EQ(gg.cellAt({ 1, 1 })->data, &a);
+    EXPECT_EQ(gg.cellAt({ 2, 1 })->data, nullptr);
+    EXPECT_FALSE(snapshot.move(&a, { 1, 2 }));
+    EXPECT_FALSE(snapshot.move(&a, { 4, 1 }));
+    EXPECT_FALSE(snapshot.move(&a, { gw, 1 }));
+
+    // Branches share pages until they write to them.
+    GameGridSnapshot branch = snapshot;
+    EXPECT_TRUE(branch.move(&a, { 3, 1 }));
+    EXPECT_TRUE(branch.move(&b, { 20, 20 }));
+    EXPECT_EQ(branch.pageCount(), 2u);
+    EXPECT_EQ(snapshot.pageCount(), 1u);
+    EXPECT_EQ(snapshot.position(&a), PositionI(2, 1));
+    EXPECT_EQ(snapshot.cellAt({ 3, 1 })->data, nullptr);
+    EXPECT_EQ(snapshot.cellAt({ 1, 2 })->data, &b);
+    EXPECT_EQ(branch.cellAt({ 1, 2 })->data, nullptr);
+    EXPECT_EQ(branch.cellAt({ 20, 20 })->data, &b);
+
+    EXPECT_TRUE(branch.leave(&b));
+    EXPECT_FALSE(branch.leave(&b));
+    EXPECT_EQ(branch.position(&b), PositionI::undefined());
+    EXPECT_EQ(branch.cellAt({ 20, 20 })->data, nullptr);
+    EXPECT_EQ(snapshot.position(&b), PositionI(1, 2));
+
+    // Type changes, and listeners that are not on the grid.
+    EXPECT_TRUE(branch.setCellType({ 4, 1 }, static_cast<u32>(CellType::Ground)));
+    EXPECT_TRUE(branch.move(&a, { 4, 1 }));
+    EXPECT_TRUE(isBlocked(*gg.cellAt({ 4, 1 })));
+    DummyGameObject c { 2, "c" };
+    EXPECT_TRUE(branch.move(&c, { 10, 10 }));
+    EXPECT_EQ(c.currentGrid(), nullptr);
+
+    EXPECT_FALSE(snapshot.stale());
+    EXPECT_TRUE(gg.setCellType({ 30, 30 }, static_cast<u32>(CellType::BlockStone)));
+    EXPECT_TRUE(snapshot.stale());
+    gg.leave(&a);
+    gg.leave(&b);
+}
+
+// Keeps the written values in memory, along with their scopes and names.
+struct MemoryEntry {
+    enum class Op : u8 {
+        Push,
+        Write,
+        Inner,
+        Pop,
+    };
+    Op op;
+    const char *name;
+    common::Value::Type type;
+    u64 bits;
+};
+
+class MemoryDataWriter : public DataWriter {
+public:
+    void push(const char *name) override { entries.push_back({ MemoryEntry::Op::Push, name, common::Value::Type::U8, 0 }); }
+    void write(const char *name, const common::Value &v) override { record(MemoryEntry::Op::Write, name, v); }
+    void writeInner(const common::Value &v) override { record(MemoryEntry::Op::Inner, "", v); }
+    bool pop() override {
+        entries.push_back({ MemoryEntry::Op::Pop, "", common::Value::Type::U8, 0 });
+        return true;
+    }
+    void flush() override {}
+
+    astl::vector<MemoryEntry> entries;
+    // Bytes taken by the values, as packed by their type.
+    u32 bytes = 0;
+
+private:
+    void record(MemoryEntry::Op op, const char *name, const common::Value &v) {
+        u64 bits = 0;
+        switch (v.type()) {
+        case common::Value::Type::U8:
+            bits = v.valueAs<u8>();
+            bytes += 1;
+            break;
+        case common::Value::Type::U16:
+            bits = v.valueAs<u16>();
+            bytes += 2;
+            break;
+        case common::Value::Type::U32:
+            bits = v.valueAs<u32>();
+            bytes += 4;
+            break;
+        default:
+            ADD_FAILURE();
+            break;
+        }
+        entries.push_back({ op, name, v.type(), bits });
+    }
+};
+
+// Reads back what a MemoryDataWriter wrote, checking scopes and names match.
+class MemoryDataReader : public DataReader {
+public:
+    MemoryDataReader(const astl::vector<MemoryEntry> &entries) : entries_(entries) {}
+    bool push(const char *name) override { return next(MemoryEntry::Op::Push, name) != nullptr; }
+    common::Value read(const char *name) override { return value(next(MemoryEntry::Op::Write, name)); }
+    common::Value readInner() override { return value(next(MemoryEntry::Op::Inner, "")); }
+    bool pop() override { return next(MemoryEntry::Op::Pop, "") != nullptr; }
+    // Whether everything was read, in order
+    bool done() const { return cursor_ == entries_.size(); }
+
+private:
+    const MemoryEntry *next(MemoryEntry::Op op, const char *name) {
+        if (cursor_ >= entries_.size() || entries_[cursor_].op != op || strcmp(entries_[cursor_].name, name) != 0) {
+            return nullptr;
+        }
+        return &entries_[cursor_++];
+    }
+    static common::Value value(const MemoryEntry *e) {
+        if (!e) {
+            return common::Value(static_cast<u64>(0));
+        }
+        switch (e->type) {
+        case common::Value::Type::U8:
+            return common::Value(static_cast<u8>(e->bits));
+        case common::Value::Type::U16:
+            return common::Value(static_cast<u16>(e->bits));
+        default:
+            return common::Value(static_cast<u32>(e->bits));
+        }
+    }
+
+    const astl::vector<MemoryEntry> &entries_;
+    u32 cursor_ = 0;
+};
+
+static u32 initTypeFuncIslands(const PositionI &p) {
+    if (p.y() > 40 && p.y() < 50) {
+        return static_cast<u32>(CellType::Water);
+    }
+    if ((p.x() * 7 + p.y() * 3) % 29 == 0) {
+        return static_cast<u32>(CellType::BlockStone);
+    }
+    return static_cast<u32>(p.x() < 32 ? CellType::Ground : CellType::GroundGrass);
+}
+
+TEST_F(UnitTests, Game_GameGrid_Serialization) {
+    constexpr u32 kSize = 64;
+    GameGrid gg { { kSize, kSize }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncIslands };
+    DummyGameObject a { 7, "a" };
+    DummyGameObject b { 9, "b" };
+    b.setSize({ 2, 2 });
+    EXPECT_EQ(gg.move(&a, { 1, 1 }), 0u);
+    EXPECT_EQ(gg.move(&b, { 20, 60 }), 0u);
+    gg.setListenerIds([](const GameGrid::Listener *ggl) {
+        return static_cast<const GameObject *>(ggl)->uid();
+    }, nullptr);
+
+    MemoryDataWriter writer;
+    gg.serialize(&writer);
+    // Far less than a byte per cell.
+    EXPECT_LT(writer.bytes, kSize * kSize / 2);
+
+    // Loads into either layout, listeners moving from one grid to the other.
+    gg.leave(&a);
+    gg.leave(&b);
+    for (GameGrid::Layout layout : { GameGrid::Layout::RowMajor, GameGrid::Layout::Chunked, GameGrid::Layout::Morton }) {
+        GameGrid loaded { { kSize, kSize }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround, layout };
+        loaded.setListenerIds(nullptr, [&](u32 id) -> GameGrid::Listener * {
+            return id == a.uid() ? &a : (id == b.uid() ? &b : nullptr);
+        });
+        loaded.setJournalEnabled(true);
+        MemoryDataReader reader { writer.entries };
+        EXPECT_TRUE(loaded.deserialize(&reader));
+        EXPECT_TRUE(reader.done());
+        u32 changed = 0;
+        skLoop(y, kSize) {
+            skLoop(x, kSize) {
+                EXPECT_EQ(loaded.cellAt({ x, y })->type, gg.cellAt({ x, y })->type);
+                changed += gg.cellAt({ x, y })->type != static_cast<u32>(CellType::Ground) ? 1 : 0;
+            }
+        }
+        // Only the cells whose type changed are journaled.
+        GameGrid::Journal journal;
+        loaded.drainJournal(journal);
+        u32 journaled = 0;
+        for (const GameGrid::CellChange &c : journal.cells) {
+            journaled += (c.flags & GameGrid::kCellTypeChanged) ? 1 : 0;
+        }
+        EXPECT_EQ(journaled, changed);
+        EXPECT_EQ(loaded.listeners().size(), 2u);
+        EXPECT_EQ(a.position(), PositionI(1, 1));
+        EXPECT_EQ(loaded.cellAt({ 21, 61 })->data, &b);
+        loaded.leave(&a);
+        loaded.leave(&b);
+    }
+
+    // Uniform data loads into chunks without allocating their cells,
+    // each tile being changed once.
+    {
+        GameGrid water { { kSize, kSize }, astl::make_shared<MoveValidatorImpl>(), static_cast<u32>(CellType::Water) };
+        MemoryDataWriter waterWriter;
+        water.serialize(&waterWriter);
+        GameGrid loaded { { kSize, kSize }, astl::make_shared<MoveValidatorImpl>(), static_cast<u32>(CellType::Ground), GameGrid::Layout::Chunked };
+        const u32 before = loaded.revision();
+        MemoryDataReader reader { waterWriter.entries };
+        EXPECT_TRUE(loaded.deserialize(&reader));
+        EXPECT_EQ(loaded.allocatedChunks(), 0u);
+        EXPECT_EQ(loaded.revision() - before, (kSize / GameGrid::kTileSize) * (kSize / GameGrid::kTileSize));
+        EXPECT_EQ(loaded.cellAt({ 63, 63 })->type, static_cast<u32>(CellType::Water));
+    }
+
+    // Partial tiles and chunks on the borders.
+    {
+        const SizeU odd { 70, 13 };
+        GameGrid source { odd, astl::make_shared<MoveValidatorImpl>(), initTypeFuncIslands };
+        MemoryDataWriter oddWriter;
+        source.serialize(&oddWriter);
+        for (GameGrid::Layout layout : { GameGrid::Layout::RowMajor, GameGrid::Layout::Chunked, GameGrid::Layout::Morton }) {
+            GameGrid loaded { odd, astl::make_shared<MoveValidatorImpl>(), static_cast<u32>(CellType::BlockStone), layout };
+            MemoryDataReader reader { oddWriter.entries };
+            EXPECT_TRUE(loaded.deserialize(&reader));
+            skLoop(y, odd.h()) {
+                skLoop(x, odd.w()) {
+                    EXPECT_EQ(loaded.cellAt({ x, y })->type, source.cellAt({ x, y })->type);
+                }
+            }
+        }
+    }
+
+    // Grids of another size are left untouched.
+    GameGrid other { { gw, gh }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround};
+    const u32 revision = other.revision();
+    MemoryDataReader reader { writer.entries };
+    EXPECT_FALSE(other.deserialize(&reader));
+    EXPECT_EQ(other.revision(), revision);
+
+    // Truncated or corrupted data is rejected as a whole.
+    GameGrid target { { kSize, kSize }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncGround };
+    const u32 targetRevision = target.revision();
+    for (u32 keep : { 3u, 6u, static_cast<u32>(writer.entries.size() / 2), static_cast<u32>(writer.entries.size() - 2) }) {
+        const astl::vector<MemoryEntry> truncated(writer.entries.begin(), writer.entries.begin() + keep);
+        MemoryDataReader truncatedReader { truncated };
+        EXPECT_FALSE(target.deserialize(&truncatedReader));
+        EXPECT_EQ(target.revision(), targetRevision);
+    }
+    // Counts far beyond the grid area.
+    for (const char *field : { "palette", "runs", "listeners" }) {
+        astl::vector<MemoryEntry> corrupted = writer.entries;
+        for (MemoryEntry &e : corrupted) {
+            if (strcmp(e.name, field) == 0) {
+                e.type = common::Value::Type::U32;
+                e.bits = 0xffffffffu;
+            }
+        }
+        MemoryDataReader corruptedReader { corrupted };
+        EXPECT_FALSE(target.deserialize(&corruptedReader));
+        EXPECT_EQ(target.revision(), targetRevision);
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests, compares the layouts
+// on radius queries and on reading the cells around a position.
+TEST_F(UnitTests, DISABLED_Game_GameGrid_LayoutBenchmark) {
+    constexpr u32 kSize = 512;
+    constexpr u32 kRadius = 8;
+    constexpr u32 kQueries = 50000;
+    constexpr u32 kSpacing = 4;
+    const char *names[] = { "RowMajor", "Chunked", "Morton" };
+    u64 results[3] = { 0, 0, 0 };
+    astl::vector<DummyGameObject> gos;
+    gos.reserve((kSize / kSpacing) * (kSize / kSpacing));
+    constexpr u32 kCapacity = (kRadius * 2 + 1) * (kRadius * 2 + 1);
+    GameGrid::Listener *buffer[kCapacity];
+
+    skLoop(l, 3) {
+        const GameGrid::Layout layout = static_cast<GameGrid::Layout>(l);
+        GameGrid gg { { kSize, kSize }, astl::make_shared<MoveValidatorImpl>(), initTypeFuncMisc, layout };
+        gos.clear();
+        for (u32 y = 1; y < kSize; y += kSpacing) {
+            for (u32 x = 1; x < kSize; x += kSpacing) {
+                gos.emplace_back(gos.size(), "go");
+                gg.move(&gos.back(), { static_cast<i32>(x), static_cast<i32>(y) });
+            }
+        }
+
+        // Same pseudo-random centers for every layout.
+        u32 seed = 12345;
+        auto nextCenter = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return PositionI((seed >> 8) % kSize, (seed >> 20) % kSize);
+        };
+        u64 found = 0;
+        const auto queryStart = std::chrono::steady_clock::now();
+        skLoop(q, kQueries) {
+            const u32 count = gg.queryRadius(nextCenter(), kRadius, buffer, kCapacity);
+            skLoop(i, count) {
+                found += buffer[i]->position().x();
+            }
+        }
+        const auto windowStart = std::chrono::steady_clock::now();
+        u64 types = 0;
+        skLoop(q, kQueries / 10) {
+            const PositionI c = nextCenter();
+            const u32 x0 = skMax(c.x() - static_cast<i32>(kRadius), 0);
+            const u32 y0 = skMax(c.y() - static_cast<i32>(kRadius), 0);
+            const u32 x1 = skMin(c.x() + kRadius, kSize - 1);
+            const u32 y1 = skMin(c.y() + kRadius, kSize - 1);
+            for (u32 y = y0; y <= y1; ++y) {
+                for (u32 x = x0; x <= x1; ++x) {
+                    types += gg.cellAtUnchecked(x, y)->type;
+                }
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+        results[l] = found + types;
+        printf("%-8s queryRadius: %6.2f ms, window reads: %6.2f ms\n", names[l],
+            std::chrono::duration<f64, std::milli>(windowStart - queryStart).count(),
+            std::chrono::duration<f64, std::milli>(end - windowStart).count());
+        for (DummyGameObject &go : gos) {
+            gg.leave(&go);
+        }
+    }
+    EXPECT_EQ(results[0], results[1]);
+    EXPECT_EQ(results[0], results[2]);
+}
+
 };
 };
@@ -0,0 +1,119 @@
+#include "TestMain.hpp"
+#include <Game.hpp>
+#include <GameCombat.hpp>
+#include <GameGrid.hpp>
+#include <GameObject.hpp>
+
+namespace spark {
+using namespace common::math;
+using namespace game;
+namespace tests {
+
+static u32 initTypeFuncTick(const PositionI &) { return 0; }
+
+class TickMoveValidator : public GameGrid::MoveValidator {
+public:
+    u32 validateMove(GameGrid *, GameGrid::Listener *, const PositionI &) override { return 0; }
+    bool isOK(u32 err) override { return err == 0; }
+    bool isWarning(u32) override { return false; }
+    bool isError(u32 err) override { return err != 0; }
+};
+
+class TickingGameObject : public DummyGameObject {
+public:
+    TickingGameObject(u32 uid, const char *name) : DummyGameObject(uid, name) {}
+    void logicUpdate(u8 logicCycle) override { cycles += logicCycle; ++updates; }
+    void onGridLogicUpdate(u8 logicCycle) override { gridCycles += logicCycle; }
+    u32 cycles = 0;
+    u32 updates = 0;
+    u32 gridCycles = 0;
+};
+
+TEST_F(UnitTests, Game_Game_Scheduler) {
+    constexpr u64 kCycle = 50;
+    Game game;
+    game.setCycleTime(kCycle);
+    GameGrid gg { { 8, 8 }, astl::make_shared<TickMoveValidator>(), initTypeFuncTick };
+    Party party { "party" };
+    TickingGameObject go { 0, "go" };
+    party.addMember(&go);
+    EXPECT_EQ(gg.move(&go, { 1, 1 }), 0u);
+    game.addGrid(&gg);
+    game.addParty(&party);
+
+    // Nothing runs before startup.
+    EXPECT_EQ(game.update(kCycle * 2), 0u);
+    EXPECT_TRUE(game.startup());
+    EXPECT_FALSE(game.startup());
+
+    // Whole cycles only, the remainder is carried over.
+    EXPECT_EQ(game.update(kCycle - 1), 0u);
+    EXPECT_EQ(game.pendingTime(), kCycle - 1);
+    EXPECT_EQ(game.update(1), 1u);
+    EXPECT_EQ(game.update(kCycle * 2 + kCycle / 2), 2u);
+    EXPECT_EQ(game.pendingTime(), kCycle / 2);
+    EXPECT_EQ(game.logicCycle(), 3u);
+    EXPECT_EQ(gg.logicCycle(), 3u);
+    EXPECT_EQ(go.cycles, 3u);
+    EXPECT_EQ(go.updates, 3u);
+    EXPECT_EQ(go.gridCycles, 3u);
+
+    // Stalls are capped, and reported.
+    game.setMaxCatchUpCycles(4);
+    EXPECT_EQ(game.update(kCycle * 10 + kCycle / 2), 4u);
+    EXPECT_EQ(game.overruns(), 1u);
+    EXPECT_EQ(game.droppedCycles(), 7u);
+    EXPECT_EQ(game.pendingTime(), 0u);
+    EXPECT_EQ(go.cycles, 7u);
+    EXPECT_EQ(go.updates, 7u);
+
+    // Catching up in larger steps.
+    game.setCatchUpStep(3);
+    EXPECT_EQ(game.update(kCycle * 4), 4u);
+    EXPECT_EQ(go.cycles, 11u);
+    EXPECT_EQ(go.updates, 9u);
+    EXPECT_EQ(game.overruns(), 1u);
+
+    // Parties in combat only run on their turn, which
+    // updates never end.
+    TickingGameObject otherGo { 1, "otherGo" };
+    Party other { "other" };
+    other.addMember(&otherGo);
+    Combat combat;
+    combat.addParty(&party);
+    combat.addParty(&other);
+    combat.enterState();
+    game.addCombat(&combat);
+    game.setCatchUpStep(1);
+    const u32 turn = combat.currentTurn();
+    const u32 updates = go.updates;
+    EXPECT_EQ(combat.currentParty(), &party);
+    EXPECT_EQ(game.update(kCycle * 4), 4u);
+    EXPECT_EQ(game.update(kCycle), 1u);
+    EXPECT_EQ(game.update(kCycle * 8), 4u);
+    EXPECT_EQ(combat.currentParty(), &party);
+    EXPECT_EQ(combat.currentTurn(), turn);
+    EXPECT_EQ(go.updates, updates + 9);
+    EXPECT_EQ(otherGo.updates, 0u);
+    EXPECT_EQ(go.gridCycles, 20u);
+
+    // Handing the turn over.
+    combat.nextParty();
+    EXPECT_EQ(combat.currentParty(), &other);
+    EXPECT_EQ(game.update(kCycle * 2), 2u);
+    EXPECT_EQ(combat.currentParty(), &other);
+    EXPECT_EQ(go.updates, updates + 9);
+    EXPECT_EQ(otherGo.updates, 3u);
+
+    combat.leaveState();
+    party.leaveCombat();
+    other.leaveCombat();
+    party.removeMember(&go);
+    other.removeMember(&otherGo);
+    gg.leave(&go);
+    EXPECT_TRUE(game.shutdown());
+    EXPECT_FALSE(game.shutdown());
+    EXPECT_EQ(game.update(kCycle), 0u);
+}
+
+}; }; // namespace spark::tests
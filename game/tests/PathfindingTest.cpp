@@ -0,0 +1,328 @@
+#include "TestMain.hpp"
+#include <GameGrid.hpp>
+#include <GameObject.hpp>
+#include <GamePathfinding.hpp>
+
+namespace spark {
+using namespace common::math;
+using namespace game;
+namespace tests {
+
+#define pw 32
+#define ph 24
+
+static constexpr u32 kPathGround = 0;
+static constexpr u32 kPathMud = 1;
+static constexpr u32 kPathWall = 2;
+
+// Walls with a few openings, plus a mud patch.
+static u32 initTypeFuncMaze(const PositionI &p) {
+    if (p.x() == 8 && p.y() != 3) {
+        return kPathWall;
+    }
+    if (p.x() == 16 && p.y() != ph-2) {
+        return kPathWall;
+    }
+    if (p.y() == 12 && p.x() > 16 && p.x() < pw-3) {
+        return kPathWall;
+    }
+    if (p.x() > 20 && p.x() < 26 && p.y() > 14 && p.y() < 20) {
+        return kPathMud;
+    }
+    return kPathGround;
+}
+
+static bool isWalkableMaze(const GameGrid::Cell &c) {
+    return c.type != kPathWall && c.data == nullptr;
+}
+
+// Accepts any move onto a walkable cell.
+class PathMoveValidator : public GameGrid::MoveValidator {
+public:
+    u32 validateMove(GameGrid *gg, GameGrid::Listener *, const PositionI &p) override {
+        const GameGrid::Cell *c = gg->cellAt(p);
+        return (c && c->type != kPathWall) ? 0u : 1u;
+    }
+    bool isOK(u32 err) override { return err == 0; }
+    bool isWarning(u32) override { return false; }
+    bool isError(u32 err) override { return err != 0; }
+};
+
+// Checks the path is made of adjacent walkable steps without corner cutting.
+static void expectValidPath(const GameGrid &gg, const PositionI &from, const astl::vector<PositionI> &path) {
+    PositionI prev = from;
+    for (const PositionI &p : path) {
+        const i32 dx = p.x() - prev.x();
+        const i32 dy = p.y() - prev.y();
+        EXPECT_LE(ni::Abs(dx), 1);
+        EXPECT_LE(ni::Abs(dy), 1);
+        EXPECT_TRUE(dx || dy);
+        EXPECT_TRUE(isWalkableMaze(*gg.cellAt(p)));
+        if (dx && dy) {
+            EXPECT_TRUE(isWalkableMaze(*gg.cellAt({ prev.x() + dx, prev.y() })));
+            EXPECT_TRUE(isWalkableMaze(*gg.cellAt({ prev.x(), prev.y() + dy })));
+        }
+        prev = p;
+    }
+}
+
+TEST_F(UnitTests, Game_Pathfinding_AStarJumpPoint) {
+    GameGrid gg { { pw, ph }, astl::make_shared<PathMoveValidator>(), initTypeFuncMaze };
+    Pathfinder pf { &gg, isWalkableMaze };
+    astl::vector<PositionI> path;
+    path.reserve(gg.area());
+
+    const PositionI from { 1, 20 };
+    const PositionI to { pw-2, 1 };
+
+    // Both algorithms find equally short paths on uniform costs.
+    EXPECT_TRUE(pf.findPath(from, to, path, Pathfinder::Algorithm::AStar));
+    const u32 astarCost = pf.lastCost();
+    const u32 astarExpanded = pf.lastExpanded();
+    EXPECT_EQ(path.back(), to);
+    expectValidPath(gg, from, path);
+
+    EXPECT_TRUE(pf.findPath(from, to, path, Pathfinder::Algorithm::JumpPoint));
+    EXPECT_EQ(pf.lastCost(), astarCost);
+    EXPECT_LT(pf.lastExpanded(), astarExpanded);
+    EXPECT_EQ(path.back(), to);
+    expectValidPath(gg, from, path);
+
+    // Paths can be fed straight into GameGrid::move.
+    DummyGameObject go { 0, "Walker" };
+    EXPECT_EQ(gg.move(&go, from), 0u);
+    for (const PositionI &p : path) {
+        EXPECT_EQ(gg.move(&go, p), 0u);
+    }
+    EXPECT_EQ(go.position(), to);
+    gg.leave(&go);
+
+    // Orthogonal moves only.
+    pf.setAllowDiagonal(false);
+    EXPECT_TRUE(pf.findPath(from, to, path));
+    EXPECT_GT(pf.lastCost(), astarCost);
+    expectValidPath(gg, from, path);
+    PositionI prev = from;
+    for (const PositionI &p : path) {
+        EXPECT_EQ(ni::Abs(p.x() - prev.x()) + ni::Abs(p.y() - prev.y()), 1);
+        prev = p;
+    }
+    pf.setAllowDiagonal(true);
+
+    // Trivial and impossible queries.
+    EXPECT_TRUE(pf.findPath(from, from, path));
+    EXPECT_TRUE(path.empty());
+    EXPECT_FALSE(pf.findPath(from, { 8, 0 }, path));
+    EXPECT_FALSE(pf.findPath(from, { pw, 0 }, path));
+    EXPECT_TRUE(path.empty());
+
+    // Occupied cells are not walkable through the predicate.
+    DummyGameObject blocker { 1, "Blocker" };
+    EXPECT_EQ(gg.move(&blocker, { 8, 3 }), 0u);
+    EXPECT_FALSE(pf.findPath(from, to, path, Pathfinder::Algorithm::JumpPoint));
+    EXPECT_FALSE(pf.findPath(from, to, path, Pathfinder::Algorithm::AStar));
+    gg.leave(&blocker);
+}
+
+TEST_F(UnitTests, Game_Pathfinding_TypeCosts) {
+    GameGrid gg { { pw, ph }, astl::make_shared<PathMoveValidator>(), initTypeFuncMaze };
+    Pathfinder pf { &gg, isWalkableMaze };
+    astl::vector<PositionI> path;
+
+    // Straight through the mud patch.
+    const PositionI from { 20, 17 };
+    const PositionI to { 27, 17 };
+    EXPECT_TRUE(pf.findPath(from, to, path));
+    EXPECT_EQ(pf.lastCost(), 7 * Pathfinder::kStraightCost);
+
+    // Expensive mud gets walked around.
+    pf.setTypeCost(kPathMud, 10);
+    EXPECT_TRUE(pf.findPath(from, to, path));
+    expectValidPath(gg, from, path);
+    for (const PositionI &p : path) {
+        EXPECT_NE(gg.cellAt(p)->type, kPathMud);
+    }
+    EXPECT_GT(pf.lastCost(), 7 * Pathfinder::kStraightCost);
+
+    // Jump Point Search falls back to A* on weighted grids.
+    const u32 astarCost = pf.lastCost();
+    EXPECT_TRUE(pf.findPath(from, to, path, Pathfinder::Algorithm::JumpPoint));
+    EXPECT_EQ(pf.lastCost(), astarCost);
+}
+
+TEST_F(UnitTests, Game_Pathfinding_FlowField) {
+    GameGrid gg { { pw, ph }, astl::make_shared<PathMoveValidator>(), initTypeFuncMaze };
+    Pathfinder pf { &gg, isWalkableMaze };
+    FlowField ff { &gg, isWalkableMaze };
+    astl::vector<PositionI> path;
+
+    // Not built yet.
+    EXPECT_FALSE(ff.valid());
+    const PositionI goal { pw-2, 1 };
+    ff.setGoal(goal);
+    EXPECT_TRUE(ff.update());
+    EXPECT_TRUE(ff.valid());
+    EXPECT_FALSE(ff.update());
+
+    // Distances match single searches, and following
+    // the flow reaches the goal in as many steps.
+    for (const PositionI &from : { PositionI(1, 20), PositionI(1, 1), PositionI(20, 20), PositionI(pw-2, ph-2) }) {
+        EXPECT_TRUE(pf.findPath(from, goal, path));
+        EXPECT_EQ(ff.distance(from), pf.lastCost());
+        PositionI p = from;
+        u32 steps = 0;
+        while (ff.nextStep(p, &p)) {
+            ++steps;
+            EXPECT_LE(steps, path.size());
+        }
+        EXPECT_EQ(p, goal);
+        EXPECT_EQ(steps, path.size());
+    }
+    EXPECT_EQ(ff.distance(goal), 0u);
+    EXPECT_EQ(ff.distance({ pw, 0 }), FlowField::kUnreachable);
+
+    // Agents moving around do not invalidate an occupancy independent field.
+    DummyGameObject go { 0, "Agent" };
+    EXPECT_EQ(gg.move(&go, { 1, 20 }), 0u);
+    EXPECT_TRUE(ff.valid());
+
+    // Closing the only gap of the first wall does.
+    EXPECT_TRUE(gg.setCellType({ 8, 3 }, kPathWall));
+    EXPECT_FALSE(ff.valid());
+    EXPECT_TRUE(ff.update());
+    EXPECT_EQ(ff.distance({ 1, 20 }), FlowField::kUnreachable);
+
+    // Occupancy dependent fields see agents as obstacles,
+    // while still giving a direction to the cells they stand on.
+    EXPECT_TRUE(gg.setCellType({ 8, 3 }, kPathGround));
+    ff.setDependsOnOccupancy(true);
+    EXPECT_TRUE(ff.update());
+    PositionI next;
+    EXPECT_TRUE(ff.nextStep(go.position(), &next));
+    EXPECT_EQ(gg.move(&go, { 2, 20 }), 0u);
+    EXPECT_FALSE(ff.valid());
+    gg.leave(&go);
+
+    // Multiple goals, distances go to the closest one.
+    const PositionI goals[] = { { 1, 1 }, { pw-2, ph-2 } };
+    ff.setGoals(goals, 2);
+    EXPECT_TRUE(ff.update());
+    EXPECT_EQ(ff.distance({ 1, 3 }), 2 * Pathfinder::kStraightCost);
+    EXPECT_EQ(ff.distance({ pw-2, ph-4 }), 2 * Pathfinder::kStraightCost);
+    ff.setGoals(goals, 2);
+    EXPECT_FALSE(ff.update());
+}
+
+TEST_F(UnitTests, Game_Pathfinding_FlowFieldArea) {
+    GameGrid gg { { pw, ph }, astl::make_shared<PathMoveValidator>(), initTypeFuncMaze };
+
+    // Only covers the left room.
+    FlowField ff { &gg, isWalkableMaze, { 0, 0 }, { 7, ph-1 } };
+    ff.setGoal({ 1, 1 });
+    EXPECT_TRUE(ff.update());
+    EXPECT_EQ(ff.distance({ 1, 4 }), 3 * Pathfinder::kStraightCost);
+    EXPECT_EQ(ff.distance({ 10, 1 }), FlowField::kUnreachable);
+
+    // Changes outside of the covered tiles keep the field valid.
+    EXPECT_TRUE(gg.setCellType({ 20, 20 }, kPathWall));
+    EXPECT_TRUE(ff.valid());
+    EXPECT_TRUE(gg.setCellType({ 4, 4 }, kPathWall));
+    EXPECT_FALSE(ff.valid());
+}
+
+TEST_F(UnitTests, Game_Pathfinding_Traits) {
+    GameGrid gg { { pw, ph }, astl::make_shared<PathMoveValidator>(), initTypeFuncMaze };
+    gg.setTypeTraits(kPathGround, GameGrid::kTraitWalkable);
+    gg.setTypeTraits(kPathMud, GameGrid::kTraitWalkable);
+    astl::vector<PositionI> path;
+
+    // Without a predicate, walkability comes from the grid traits.
+    Pathfinder pf { &gg, isWalkableMaze };
+    Pathfinder traits { &gg, nullptr };
+    for (Pathfinder::Algorithm algorithm : { Pathfinder::Algorithm::AStar, Pathfinder::Algorithm::JumpPoint }) {
+        EXPECT_TRUE(pf.findPath({ 1, 20 }, { pw-2, 1 }, path, algorithm));
+        EXPECT_TRUE(traits.findPath({ 1, 20 }, { pw-2, 1 }, path, algorithm));
+        EXPECT_EQ(traits.lastCost(), pf.lastCost());
+        expectValidPath(gg, { 1, 20 }, path);
+    }
+
+    FlowField ff { &gg, nullptr };
+    ff.setGoal({ pw-2, 1 });
+    EXPECT_TRUE(ff.update());
+    EXPECT_EQ(ff.distance({ 1, 20 }), pf.lastCost());
+    EXPECT_LT(ff.distance({ 8, 3 }), FlowField::kUnreachable);
+    EXPECT_TRUE(gg.setCellType({ 8, 3 }, kPathWall));
+    EXPECT_TRUE(ff.update());
+    EXPECT_EQ(ff.distance({ 1, 20 }), FlowField::kUnreachable);
+}
+
+// Sums the step costs of a path, on uniform costs.
+static u32 pathCost(const PositionI &from, const astl::vector<PositionI> &path) {
+    u32 cost = 0;
+    PositionI prev = from;
+    for (const PositionI &p : path) {
+        cost += (p.x() != prev.x() && p.y() != prev.y()) ? Pathfinder::kDiagonalCost : Pathfinder::kStraightCost;
+        prev = p;
+    }
+    return cost;
+}
+
+TEST_F(UnitTests, Game_Pathfinding_Hierarchical) {
+    GameGrid gg { { pw, ph }, astl::make_shared<PathMoveValidator>(), initTypeFuncMaze };
+    Pathfinder pf { &gg, isWalkableMaze };
+    HierarchicalPathfinder hpf { &gg, isWalkableMaze, 8 };
+    astl::vector<PositionI> path;
+    astl::vector<PositionI> waypoints;
+    EXPECT_EQ(hpf.clusterCount(), 12u);
+    EXPECT_EQ(hpf.update(), 12u);
+    EXPECT_EQ(hpf.update(), 0u);
+    EXPECT_GT(hpf.nodeCount(), 0u);
+
+    // Close to the optimal cost, and refined paths cost what was planned.
+    const PositionI froms[] = { { 1, 20 }, { 1, 1 }, { 20, 20 }, { pw-2, ph-2 }, { 10, 10 } };
+    const PositionI tos[] = { { pw-2, 1 }, { 6, 6 }, { 3, 22 }, { 17, 13 }, { 28, 22 } };
+    skLoop(i, 5) {
+        EXPECT_TRUE(pf.findPath(froms[i], tos[i], path));
+        const u32 optimal = pf.lastCost();
+        EXPECT_TRUE(hpf.findPath(froms[i], tos[i], path));
+        EXPECT_EQ(path.back(), tos[i]);
+        expectValidPath(gg, froms[i], path);
+        EXPECT_EQ(pathCost(froms[i], path), hpf.lastCost());
+        EXPECT_GE(hpf.lastCost(), optimal);
+        EXPECT_LE(hpf.lastCost(), optimal + optimal / 5);
+    }
+
+    // Waypoints can be refined one at a time.
+    EXPECT_TRUE(hpf.findAbstractPath({ 1, 20 }, { pw-2, 1 }, waypoints));
+    EXPECT_EQ(waypoints.back(), PositionI(pw-2, 1));
+    path.clear();
+    PositionI prev { 1, 20 };
+    for (const PositionI &p : waypoints) {
+        EXPECT_TRUE(hpf.refineSegment(prev, p, path));
+        prev = p;
+    }
+    expectValidPath(gg, { 1, 20 }, path);
+    EXPECT_EQ(path.back(), PositionI(pw-2, 1));
+
+    // Trivial and impossible queries.
+    EXPECT_TRUE(hpf.findPath({ 1, 20 }, { 1, 20 }, path));
+    EXPECT_TRUE(path.empty());
+    EXPECT_FALSE(hpf.findPath({ 1, 20 }, { 8, 0 }, path));
+    EXPECT_FALSE(hpf.findPath({ 1, 20 }, { pw, 0 }, path));
+
+    // Changes only repair the clusters around them.
+    EXPECT_TRUE(gg.setCellType({ 20, 20 }, kPathWall));
+    EXPECT_EQ(hpf.update(), 4u);
+    EXPECT_EQ(hpf.update(), 0u);
+
+    // Closing the only gap of the first wall.
+    EXPECT_TRUE(gg.setCellType({ 8, 3 }, kPathWall));
+    EXPECT_FALSE(hpf.findPath({ 1, 20 }, { pw-2, 1 }, path));
+    EXPECT_TRUE(hpf.findPath({ 1, 20 }, { 6, 6 }, path));
+    expectValidPath(gg, { 1, 20 }, path);
+    EXPECT_TRUE(gg.setCellType({ 8, 3 }, kPathGround));
+    EXPECT_TRUE(hpf.findPath({ 1, 20 }, { pw-2, 1 }, path));
+    expectValidPath(gg, { 1, 20 }, path);
+}
+
+}; }; // namespace spark::tests
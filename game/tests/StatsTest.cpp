@@ -0,0 +1,162 @@
+#include "TestMain.hpp"
+#include <Game.hpp>
+#include <GameAura.hpp>
+#include <GameStats.hpp>
+#include <objects/Character.hpp>
+
+namespace spark {
+using namespace common::math;
+using namespace game;
+namespace tests {
+
+TEST_F(UnitTests, Game_Stats_Table) {
+    constexpr u32 kRows = 1000;
+    StatsTable table;
+    astl::vector<Stats> reference;
+    reference.reserve(kRows);
+    skLoop(i, kRows) {
+        reference.push_back(Stats { 1 + i % 13, 2 + i % 7, 3 + i % 11 });
+        EXPECT_EQ(table.addRow(reference.back()), static_cast<StatsTable::Row>(i));
+    }
+    EXPECT_EQ(table.rowCount(), kRows);
+
+    // Derived stats match the per object computation.
+    EXPECT_EQ(table.computeStats(), kRows);
+    EXPECT_EQ(table.computeStats(), 0u);
+    auto expectMatches = [&]() {
+        skLoop(i, kRows) {
+            reference[i].computeStats();
+            for (Stats::Type t : { Stats::Type::Strength, Stats::Type::Intelligence, Stats::Type::MaxHitPoints,
+                                   Stats::Type::AttackPower, Stats::Type::SpellPower, Stats::Type::MaxActionPoints }) {
+                EXPECT_EQ(table.computed(i, t), reference[i].computed(t));
+            }
+        }
+    };
+    expectMatches();
+
+    // Only the touched rows get recomputed.
+    for (u32 i = 0; i < kRows; i += 10) {
+        table.applyStatMultiplier(i, Stats::Type::Strength, 0.5f);
+        reference[i].applyStatMultiplier(Stats::Type::Strength, 0.5f);
+        table.applyStatAdditive(i, Stats::Type::Strength, 3);
+        reference[i].applyStatAdditive(Stats::Type::Strength, 3);
+    }
+    table.applyStatAdditive(5, Stats::Type::MaxHitPoints, 7);
+    reference[5].applyStatAdditive(Stats::Type::MaxHitPoints, 7);
+    EXPECT_FALSE(table.dirty(5));
+    EXPECT_TRUE(table.dirty(10));
+    EXPECT_EQ(table.computeStats(), kRows / 10);
+    expectMatches();
+
+    table.expireStatAdditive(10, Stats::Type::Strength, 3);
+    reference[10].expireStatAdditive(Stats::Type::Strength, 3);
+    table.resetAll(20);
+    reference[20].resetAll();
+    EXPECT_EQ(table.computeStats(), 2u);
+    expectMatches();
+
+    // Removed rows get recycled.
+    table.markDirty(30);
+    table.removeRow(30);
+    EXPECT_FALSE(table.isValid(30));
+    EXPECT_EQ(table.rowCount(), kRows - 1);
+    EXPECT_EQ(table.computeStats(), 0u);
+    EXPECT_EQ(table.addRow(Stats { 4, 4, 4 }), 30u);
+    EXPECT_EQ(table.computeStats(), 1u);
+    EXPECT_EQ(table.computed(30, Stats::Type::MaxHitPoints), 40);
+    EXPECT_EQ(table.computed(30, Stats::Type::SpellPower), 4);
+}
+
+class AdditiveIntelligenceAuraImpl : public AdditiveAura<Stats::Type::Intelligence> {
+public:
+    AdditiveIntelligenceAuraImpl(u32 uid, i32 add)
+        : AdditiveAura<Stats::Type::Intelligence>(uid, add) {
+    }
+    const char *name() const override {
+        return "AdditiveIntelligenceAura";
+    }
+};
+
+TEST_F(UnitTests, Game_Stats_TableCharacters) {
+    // Intelligence is an attribute too.
+    EXPECT_TRUE(Stats::isAttribute(Stats::Type::Intelligence));
+    EXPECT_FALSE(Stats::isAttribute(Stats::Type::MaxHitPoints));
+    EXPECT_TRUE(Stats::isStat(Stats::Type::SpellPower));
+    Stats stats { 1, 1, 1 };
+    stats.computeStats();
+    stats.set(Stats::Type::Intelligence, 4);
+    EXPECT_TRUE(stats.dirty());
+
+    // Characters in a table against computing their own.
+    constexpr u32 kCharacters = 16;
+    StatsTable table;
+    Game game;
+    game.setStatsTable(&table);
+    EXPECT_TRUE(game.startup());
+    astl::vector<astl::unique_ptr<Character>> shared;
+    astl::vector<astl::unique_ptr<Character>> own;
+    skLoop(i, kCharacters) {
+        const Stats base { 1 + i, 2 + i % 3, 3 + i % 5 };
+        shared.emplace_back(new Character { static_cast<u32>(i), "Shared", base });
+        own.emplace_back(new Character { static_cast<u32>(i), "Own", base });
+        shared.back()->setStatsTable(&table);
+    }
+    EXPECT_EQ(table.rowCount(), kCharacters);
+    astl::shared_ptr<AdditiveIntelligenceAuraImpl> aura = astl::make_shared<AdditiveIntelligenceAuraImpl>(0, 5);
+    auto expectMatches = [&]() {
+        skLoop(i, kCharacters) {
+            for (Stats::Type t : { Stats::Type::Strength, Stats::Type::Intelligence, Stats::Type::MaxHitPoints,
+                                   Stats::Type::AttackPower, Stats::Type::SpellPower, Stats::Type::MaxActionPoints }) {
+                EXPECT_EQ(shared[i]->computed(t), own[i]->computed(t));
+            }
+            EXPECT_EQ(shared[i]->currentHitPoints(), own[i]->currentHitPoints());
+            EXPECT_EQ(shared[i]->currentActionPoints(), own[i]->currentActionPoints());
+        }
+    };
+    auto step = [&]() {
+        skLoop(i, kCharacters) {
+            shared[i]->processDirty();
+            own[i]->processDirty();
+        }
+        EXPECT_EQ(game.update(game.cycleTime()), 1u);
+    };
+    step();
+    expectMatches();
+    // Clamped once the table computed them.
+    EXPECT_EQ(shared[0]->currentHitPoints(), 10);
+    EXPECT_EQ(shared[kCharacters - 1]->currentHitPoints(), 160);
+
+    // Derived stats follow attributes and auras, on the next step.
+    skLoop(i, kCharacters) {
+        if (i % 2) {
+            shared[i]->applyAura(*shared[i], aura);
+            own[i]->applyAura(*own[i], aura);
+        }
+        else {
+            shared[i]->rwStats().set(Stats::Type::Strength, 7);
+            own[i]->rwStats().set(Stats::Type::Strength, 7);
+        }
+    }
+    step();
+    expectMatches();
+    EXPECT_EQ(shared[1]->computed(Stats::Type::SpellPower), own[1]->stats().computed(Stats::Type::SpellPower));
+    EXPECT_EQ(shared[0]->maxHitPoints(), 70);
+
+    // Lowering max hit points clamps the current ones.
+    shared[kCharacters - 1]->rwStats().set(Stats::Type::Strength, 3);
+    own[kCharacters - 1]->rwStats().set(Stats::Type::Strength, 3);
+    step();
+    expectMatches();
+    EXPECT_EQ(shared[kCharacters - 1]->currentHitPoints(), 30);
+
+    // Back to computing their own.
+    shared[0]->setStatsTable(nullptr);
+    EXPECT_EQ(table.rowCount(), kCharacters - 1);
+    shared[0]->processDirty();
+    EXPECT_EQ(shared[0]->maxHitPoints(), 70);
+    shared.clear();
+    EXPECT_EQ(table.rowCount(), 0u);
+    EXPECT_TRUE(game.shutdown());
+}
+
+}; }; // namespace spark::tests
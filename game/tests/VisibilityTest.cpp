@@ -0,0 +1,171 @@
+#include "TestMain.hpp"
+#include <GameGrid.hpp>
+#include <GameObject.hpp>
+#include <GameVisibility.hpp>
+#include <objects/Character.hpp>
+
+namespace spark {
+using namespace common::math;
+using namespace game;
+namespace tests {
+
+#define vw 24
+#define vh 20
+
+static constexpr u32 kSightFloor = 0;
+static constexpr u32 kSightPillar = 1;
+static constexpr u32 kSightGlass = 2; // Blocks moves, not sight
+
+// A wall with a door, and a few scattered pillars.
+static u32 initTypeFuncSight(const PositionI &p) {
+    if (p.x() == 12 && p.y() != 10) {
+        return kSightPillar;
+    }
+    if ((p.x() == 5 && p.y() == 5) || (p.x() == 6 && p.y() == 14) || (p.x() == 18 && p.y() == 4)) {
+        return kSightPillar;
+    }
+    if (p.x() == 3 && p.y() == 10) {
+        return kSightGlass;
+    }
+    return kSightFloor;
+}
+
+static bool blocksSightPillar(u32 type) {
+    return type == kSightPillar;
+}
+
+class SightMoveValidator : public GameGrid::MoveValidator {
+public:
+    u32 validateMove(GameGrid *gg, GameGrid::Listener *, const PositionI &p) override {
+        const GameGrid::Cell *c = gg->cellAt(p);
+        return (c && c->type == kSightFloor) ? 0u : 1u;
+    }
+    bool isOK(u32 err) override { return err == 0; }
+    bool isWarning(u32) override { return false; }
+    bool isError(u32 err) override { return err != 0; }
+};
+
+TEST_F(UnitTests, Game_Visibility_LineOfSight) {
+    GameGrid gg { { vw, vh }, astl::make_shared<SightMoveValidator>(), initTypeFuncSight };
+
+    // Nothing blocks sight until a predicate is set.
+    EXPECT_TRUE(gg.hasLineOfSight({ 1, 1 }, { 20, 1 }));
+    gg.setBlocksSight(blocksSightPillar);
+    EXPECT_FALSE(gg.hasLineOfSight({ 1, 1 }, { 20, 1 }));
+    EXPECT_FALSE(gg.blocksSight(3, 10));
+    EXPECT_TRUE(gg.blocksSight(12, 0));
+
+    // Through the door, and past the glass.
+    EXPECT_TRUE(gg.hasLineOfSight({ 1, 10 }, { 20, 10 }));
+    EXPECT_TRUE(gg.hasLineOfSight({ 10, 9 }, { 14, 11 }));
+    EXPECT_TRUE(gg.hasLineOfSight({ 1, 1 }, { 1, 1 }));
+
+    // End cells do not block.
+    EXPECT_TRUE(gg.hasLineOfSight({ 11, 3 }, { 12, 3 }));
+    EXPECT_TRUE(gg.hasLineOfSight({ 4, 4 }, { 5, 5 }));
+    EXPECT_FALSE(gg.hasLineOfSight({ 4, 4 }, { 6, 6 }));
+
+    // Out of the grid.
+    EXPECT_FALSE(gg.hasLineOfSight({ -1, 1 }, { 1, 1 }));
+    EXPECT_FALSE(gg.hasLineOfSight({ 1, 1 }, { vw, 1 }));
+
+    // Symmetric.
+    for (i32 y0 = 0; y0 < vh; y0 += 3) {
+        for (i32 x0 = 0; x0 < vw; x0 += 2) {
+            skLoop(y1, vh) {
+                skLoop(x1, vw) {
+                    EXPECT_EQ(gg.hasLineOfSight({ x0, y0 }, { x1, y1 }), gg.hasLineOfSight({ x1, y1 }, { x0, y0 }));
+                }
+            }
+        }
+    }
+}
+
+TEST_F(UnitTests, Game_Visibility_FieldOfView) {
+    GameGrid gg { { vw, vh }, astl::make_shared<SightMoveValidator>(), initTypeFuncSight };
+    constexpr u32 kRadius = 8;
+    FieldOfView fov { &gg, kRadius };
+
+    // Open grid, everything within the radius is visible.
+    fov.compute({ 4, 10 }, kRadius);
+    u32 expected = 0;
+    skLoop(y, vh) {
+        skLoop(x, vw) {
+            const bool inRadius = skDistance(PositionI(4, 10), PositionI(x, y)) <= kRadius;
+            expected += inRadius ? 1 : 0;
+            EXPECT_EQ(fov.isVisible({ x, y }), inRadius);
+        }
+    }
+    EXPECT_EQ(fov.visibleCount(), expected);
+    EXPECT_FALSE(fov.isVisible({ -1, 10 }));
+
+    gg.setBlocksSight(blocksSightPillar);
+    fov.compute({ 8, 5 }, kRadius);
+    EXPECT_TRUE(fov.isVisible({ 8, 5 }));
+    // The wall itself is visible, not what lies behind it.
+    EXPECT_TRUE(fov.isVisible({ 12, 5 }));
+    EXPECT_FALSE(fov.isVisible({ 13, 5 }));
+    // The pillar casts a shadow.
+    EXPECT_TRUE(fov.isVisible({ 5, 5 }));
+    EXPECT_FALSE(fov.isVisible({ 4, 5 }));
+    EXPECT_FALSE(fov.isVisible({ 2, 5 }));
+    // Out of range.
+    EXPECT_FALSE(fov.isVisible({ 8, 5 + kRadius + 1 }));
+
+    // Larger radii get clamped.
+    fov.compute({ 8, 5 }, kRadius * 2);
+    EXPECT_EQ(fov.radius(), kRadius);
+
+    // Floor visibility is symmetric.
+    FieldOfView other { &gg, kRadius };
+    for (i32 y0 = 0; y0 < vh; y0 += 2) {
+        for (i32 x0 = 0; x0 < vw; x0 += 3) {
+            if (gg.blocksSight(x0, y0)) {
+                continue;
+            }
+            fov.compute({ x0, y0 }, kRadius);
+            skLoop(y1, vh) {
+                skLoop(x1, vw) {
+                    if (gg.blocksSight(x1, y1) || !fov.isVisible({ x1, y1 })) {
+                        continue;
+                    }
+                    other.compute({ x1, y1 }, kRadius);
+                    EXPECT_TRUE(other.isVisible({ x0, y0 }));
+                }
+            }
+        }
+    }
+}
+
+class SightSkill : public Skill {
+public:
+    SightSkill(Skill::Bundle bundle) : Skill(bundle) {}
+    u8 onBeginCast(const ResolutionInfo &, const astl::shared_ptr<Skill::Params>) override { return 0; }
+    u8 onCast() override { return 0; }
+    void onResolveCast() override {}
+};
+
+TEST_F(UnitTests, Game_Visibility_CastSkill) {
+    GameGrid gg { { vw, vh }, astl::make_shared<SightMoveValidator>(), initTypeFuncSight };
+    gg.setBlocksSight(blocksSightPillar);
+
+    Character caster { 0, "Caster", { 1, 1, 1 } };
+    caster.processDirty();
+    caster.activate();
+    Skill::Bundle bundle;
+    bundle.id = 0;
+    bundle.cost = 0;
+    bundle.range = 10;
+    bundle.baseCooldown = 0;
+    caster.skillBundle()->learnSkill(astl::make_shared<SightSkill>(bundle));
+    caster.skillBundle()->resizeEquipment(1);
+    caster.skillBundle()->equipSkill(0, 0);
+
+    EXPECT_EQ(gg.move(&caster, { 9, 5 }), 0u);
+    EXPECT_EQ(caster.canCastSkill(0, { 11, 5 }), Skill::CastError::OK);
+    EXPECT_EQ(caster.canCastSkill(0, { 15, 5 }), Skill::CastError::OutOfSight);
+    EXPECT_EQ(caster.canCastSkill(0, { 9, 16 }), Skill::CastError::OutOfRange);
+    gg.leave(&caster);
+}
+
+}; }; // namespace spark::tests